@@ -1,12 +1,17 @@
 #version 330
 
 layout(location=0) in vec2 aPos;
-layout(location=1) in vec4 aColor;
+layout(location=1) in vec2 aNormal;
+layout(location=2) in uint aStyle;
 uniform mat4 uVP;
+uniform samplerBuffer uStyles; // Per style: color, then (half thickness, shown, 0, 0).
+uniform int uStyleBase; // Style of the table's first entry.
 out vec4 vColor;
 
 void main()
 {
-    vColor = aColor;
-    gl_Position = uVP * vec4(aPos, 0.0, 1.0);
-}
\ No newline at end of file
+    int style = int(aStyle) - uStyleBase;
+    vColor = texelFetch(uStyles, style * 2);
+    float halfPx = texelFetch(uStyles, style * 2 + 1).x;
+    gl_Position = uVP * vec4(aPos + aNormal * halfPx, 0.0, 1.0);
+}
@@ -0,0 +1,37 @@
+#version 330
+
+// One instance per pair of consecutive points; gl_VertexID picks the quad corner
+// (a - off, a + off, b - off, b + off as a triangle strip).
+layout(location=0) in float aX;
+layout(location=1) in float aY;
+layout(location=2) in float aNextX;
+layout(location=3) in float aNextY;
+layout(location=4) in uint aLine;
+layout(location=5) in uint aNextLine;
+uniform mat4 uVP;
+uniform samplerBuffer uStyles; // Per line: color, then (half thickness, shown, 0, 0).
+uniform int uStyleBase; // Line of the table's first entry.
+out vec4 vColor;
+
+void main()
+{
+    vec2 a = vec2(aX, aY);
+    vec2 b = vec2(aNextX, aNextY);
+    vec2 d = b - a;
+    float len = length(d);
+    int line = int(aLine) - uStyleBase;
+    vec4 style = texelFetch(uStyles, line * 2 + 1);
+    vColor = texelFetch(uStyles, line * 2);
+
+    // A pair spanning two lines, a hidden line or a zero-length segment collapses to one
+    // point outside the clip volume and draws nothing.
+    if (aLine != aNextLine || style.y == 0.0 || len <= 1e-6)
+    {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        return;
+    }
+
+    vec2 off = vec2(-d.y, d.x) * (style.x / len);
+    vec2 p = (gl_VertexID < 2 ? a : b) + ((gl_VertexID & 1) == 0 ? -off : off);
+    gl_Position = uVP * vec4(p, 0.0, 1.0);
+}
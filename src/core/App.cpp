@@ -1,11 +1,15 @@
 #include "App.h"
 #include "../render/Transforms.h"
 #include "../util/SaveSystem.h"
+#include "../util/ThreadPool.h"
 #include "../util/Util.h"
 
 #include <algorithm>
+#include <chrono>
 #include <filesystem>
+#include <functional>
 #include <iostream>
+#include <random>
 
 #include <gtc/matrix_transform.hpp>
 #include <imgui.h>
@@ -14,6 +18,7 @@
 
 static const char* GLSL_VER = "#version 330";
 
+
 // Framebuffer/camera.
 void App::framebufferSizeCallback(GLFWwindow*, int W, int H)
 {
@@ -90,6 +95,7 @@ bool App::init(int w, int h, const std::string& title)
 
 void App::shutdown()
 {
+    effects.stop();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -98,17 +104,264 @@ void App::shutdown()
     glfwTerminate();
 }
 
+// World-space rectangle on screen.
+void App::viewBounds(glm::vec2& lo, glm::vec2& hi) const
+{
+    const glm::vec2 halfView = 0.5f * glm::vec2((float)fbW, (float)fbH) / doc.camZoom;
+    lo = doc.camCenter - halfView;
+    hi = doc.camCenter + halfView;
+}
+
 // Effect cache.
-void App::updateEffect(Line& l)
+// Iterations to build at: the line's own, or fewer when LOD finds them sub-pixel.
+void App::effectTargetIters(const Line& l, float pxPerUnit, int& koch2Iters, int& dragonIters) const
+{
+    koch2Iters = l.koch2Iters;
+    dragonIters = l.dragonIters;
+    if (lodEnabled) lodClampIters(glm::length(l.b - l.a) * pxPerUnit, lodTolerancePx, koch2Iters, dragonIters, lineRuleShrink(l));
+}
+
+// Analytic statistics of a chain; a handful of chains cover the whole document.
+const CurveStats& App::chainStats(CurveRule rule, int koch2Iters, int dragonIters)
+{
+    const uint64_t key = (uint64_t(uint32_t(rule)) << 48) | (uint64_t(uint32_t(koch2Iters)) << 24) | uint32_t(dragonIters);
+    auto it = statsMemo.find(key);
+    if (it == statsMemo.end()) it = statsMemo.emplace(key, curveStats(rule, koch2Iters, dragonIters)).first;
+    return it->second;
+}
+
+// World bounds of a built-in chain on the line, stroke included. Random variants have no
+// precomputed bounds; they use the reach every chain stays within.
+void App::chainBounds(const Line& l, CurveRule rule, int koch2Iters, int dragonIters, glm::vec2& lo, glm::vec2& hi)
+{
+    if (lineVariant(l) || l.effectVariant)
+    {
+        const glm::vec2 r(kSubtreeReach * glm::length(l.b - l.a));
+        lo = 0.5f * (l.a + l.b) - r;
+        hi = 0.5f * (l.a + l.b) + r;
+    }
+    else
+    {
+        curveWorldBounds(chainStats(rule, koch2Iters, dragonIters), l.a, l.b, lo, hi);
+    }
+
+    // Thickness is in world units; the stroke reaches half of it past the centerline.
+    const float margin = 0.5f * l.thicknessPx;
+    lo -= glm::vec2(margin);
+    hi += glm::vec2(margin);
+}
+
+// Whether a built-in chain on the line can touch the view.
+bool App::chainVisible(const Line& l, CurveRule rule, int koch2Iters, int dragonIters, const glm::vec2& viewMin, const glm::vec2& viewMax)
+{
+    glm::vec2 lo, hi;
+    chainBounds(l, rule, koch2Iters, dragonIters, lo, hi);
+    return hi.x >= viewMin.x && lo.x <= viewMax.x && hi.y >= viewMin.y && lo.y <= viewMax.y;
+}
+
+// Splits the scene budget across lines before anything is built: selected lines first, then
+// visible ones, then the rest. Within a class the smallest requests are served first and
+// their leftovers roll over to the larger ones.
+void App::allocateEffectBudget(float pxPerUnit)
+{
+    glm::vec2 lo, hi;
+    viewBounds(lo, hi);
+
+    struct Request { int rank; size_t points; Line* line; int k, d; };
+    std::vector<Request> reqs;
+    reqs.reserve(doc.originals.size());
+
+    for (auto& l : doc.originals)
+    {
+        Request r{ 2, 0, &l, 0, 0 };
+        effectTargetIters(l, pxPerUnit, r.k, r.d);
+        r.points = predictLineDepths(l, r.k, r.d).points;
+
+        if (std::find(doc.selection.begin(), doc.selection.end(), l.id) != doc.selection.end()) r.rank = 0;
+        else if (l.lsystem || chainVisible(l, l.rule, r.k, r.d, lo, hi)) r.rank = 1; // L-systems have no analytic bounds.
+
+        reqs.push_back(r);
+    }
+
+    std::sort(reqs.begin(), reqs.end(), [](const Request& x, const Request& y)
+        {
+            return x.rank != y.rank ? x.rank < y.rank : x.points < y.points;
+        });
+
+    // Every line keeps at least its base segment.
+    const size_t budget = size_t(sceneBudgetK * 1000.0 * (adaptiveQuality ? quality.budgetScale() : 1.f));
+    size_t remaining = budget > 2 * reqs.size() ? budget - 2 * reqs.size() : 0;
+
+    sceneBudgetUsed = 0;
+    linesBudgetClamped = 0;
+
+    for (size_t i = 0; i < reqs.size(); ++i)
+    {
+        size_t classEnd = i;
+        while (classEnd < reqs.size() && reqs[classEnd].rank == reqs[i].rank) ++classEnd;
+
+        const size_t share = remaining / (classEnd - i);
+        Request& r = reqs[i];
+
+        const TransformDepths got = predictLineDepths(*r.line, r.k, r.d, std::min(share + 2, kMaxCurvePoints));
+        remaining -= got.points - 2;
+        sceneBudgetUsed += got.points;
+
+        r.line->targetKoch2 = got.koch2;
+        r.line->targetDragon = got.dragon;
+        r.line->budgetClamped = got.koch2 != r.k || got.dragon != r.d;
+        if (r.line->budgetClamped) ++linesBudgetClamped;
+    }
+}
+
+void App::updateEffects()
+{
+    // Templates arrive from the background thread; unused ones go once the cache grows large.
+    effects.collect();
+    effects.trim();
+
+    allocateEffectBudget(viewPixelScale(viewProj(), fbW, fbH));
+
+    // Lines whose held template has another chain than their target.
+    std::vector<std::pair<Line*, EffectKey>> stale;
+    for (auto& l : doc.originals)
+    {
+        if (!effectCurrent(l, l.targetKoch2, l.targetDragon)) stale.push_back({ &l, { l.rule, l.targetKoch2, l.targetDragon, l.lsystem, lineVariant(l) } });
+    }
+
+    // Background builds no line targets any more (the view or budget moved on) are cancelled.
+    std::vector<EffectKey> wanted;
+    auto request = [&](const EffectKey& k)
+        {
+            effects.request(k);
+            wanted.push_back(k);
+        };
+
+    if (stale.empty())
+    {
+        effects.retain(wanted);
+        return;
+    }
+
+    auto hold = [](Line& l, const EffectKey& k, EffectTemplate t)
+        {
+            l.effect = std::move(t);
+            l.effectRule = k.rule;
+            l.effectLSystem = k.lsystemHash();
+            l.effectVariant = k.variant;
+            l.effectKoch2 = k.koch2;
+            l.effectDragon = k.dragon;
+        };
+
+    // Progressive: lines without a usable prefix get a coarse level built now, then every
+    // line walks towards its target one cached level at a time. Each step continues from the
+    // one before it, so no level is generated twice.
+    if (backgroundEffects && progressiveEffects)
+    {
+        // Targets already cached, or nested in a deeper template (zooming out), need no steps.
+        std::erase_if(stale, [&](auto& s)
+            {
+                EffectTemplate t = effects.find(s.second);
+                if (!t) return false;
+                hold(*s.first, s.second, std::move(t));
+                return true;
+            });
+
+        std::vector<EffectKey> coarse;
+        for (auto& s : stale)
+        {
+            const EffectKey step = refineStep(*s.first, s.second);
+            if (!effects.find(step)) coarse.push_back(step);
+        }
+        effects.build(coarse);
+
+        for (auto& s : stale)
+        {
+            Line& l = *s.first;
+            for (;;)
+            {
+                const EffectKey step = refineStep(l, s.second);
+                EffectTemplate t = effects.find(step);
+                if (!t)
+                {
+                    request(step);
+                    break;
+                }
+
+                hold(l, step, std::move(t));
+                if (step == s.second) break;
+            }
+        }
+        effects.retain(wanted);
+        return;
+    }
+
+    // Templates are shared by chain, so a missing one is built once for all its lines.
+    // In the background mode lines keep their previous template until the new one arrives.
+    if (backgroundEffects)
+    {
+        for (auto& s : stale) request(s.second);
+    }
+    else
+    {
+        std::vector<EffectKey> keys;
+        keys.reserve(stale.size());
+        for (auto& s : stale) keys.push_back(s.second);
+        effects.build(keys);
+    }
+
+    effects.retain(wanted);
+
+    for (auto& s : stale)
+    {
+        if (EffectTemplate t = effects.find(s.second)) hold(*s.first, s.second, std::move(t));
+    }
+}
+
+// Next template on the way to `target`: one rule level or kProgressiveFolds folds past the
+// held one when that is a prefix of the target, otherwise the coarse prefix. L-system
+// rewrites do not nest, so their lines go from the coarse prefix straight to the target.
+EffectKey App::refineStep(const Line& l, const EffectKey& target) const
 {
-    std::vector<glm::vec2> base{ l.a, l.b };
-    l.effect = iterateTransform(base, l.koch2Iters, l.dragonIters);
-    l.dirty = false;
+    const bool sameChain = l.effect && l.effectRule == target.rule && l.effectLSystem == target.lsystemHash() && l.effectVariant == target.variant;
+    const int k = l.effectKoch2, d = l.effectDragon;
+
+    if (sameChain && k == target.koch2 && d <= target.dragon)
+    {
+        return { target.rule, k, std::min(d + kProgressiveFolds, target.dragon), target.lsystem, target.variant };
+    }
+    if (sameChain && !target.lsystem && d == 0 && k < target.koch2)
+    {
+        return { target.rule, k + 1, 0, nullptr, target.variant };
+    }
+
+    const TransformDepths c = predictLineDepths(l, target.koch2, target.dragon, kProgressiveCoarsePoints);
+    const EffectKey first{ target.rule, c.koch2, c.dragon, target.lsystem, target.variant };
+
+    // Already at the coarse level (or past it on another path): go straight on.
+    if (sameChain && target.lsystem && k == c.koch2 && d == c.dragon) return target;
+    return first;
 }
 
-void App::rebuildEffectsIfDirty()
+// Adds a compiled L-system, or replaces the one with its name and moves that one's lines over.
+// Their templates are keyed by the program hash, so they rebuild on the next frame.
+void App::defineLSystem(std::shared_ptr<const LSystemProgram> prog)
 {
-    for (auto& l : doc.originals) if (l.dirty) updateEffect(l);
+    auto it = std::find_if(doc.lsystems.begin(), doc.lsystems.end(), [&](const auto& p) { return p->source.name == prog->source.name; });
+    if (it == doc.lsystems.end())
+    {
+        doc.lsystems.push_back(prog);
+    }
+    else
+    {
+        for (auto& l : doc.originals)
+        {
+            if (l.lsystem == *it) l.lsystem = prog;
+        }
+        *it = prog;
+    }
+
+    uiLSystem = std::move(prog);
 }
 
 // Picking.
@@ -153,7 +406,7 @@ static void rebuildRegularPolyLines(Document& doc, RegularPolyGroup& g)
         glm::vec2 p1 = g.center + g.radius * glm::vec2(std::cos(t1), std::sin(t1));
         if (auto* l = findLine(doc, g.lineIds[i]))
         {
-            l->a = p0; l->b = p1; l->dirty = true;
+            l->a = p0; l->b = p1;
         }
     }
 }
@@ -230,7 +483,7 @@ void App::handleInput()
     {
         glm::vec2 before = screenToWorld(mx, my);
         float z = doc.camZoom * (io.MouseWheel > 0 ? 1.1f : 0.9f);
-        doc.camZoom = glm::clamp(z, 0.1f, 10.f);
+        doc.camZoom = glm::clamp(z, kMinCamZoom, kMaxCamZoom);
         glm::vec2 after = screenToWorld(mx, my);
         doc.camCenter += (before - after);
         if (!std::isfinite(doc.camZoom)) doc.camZoom = 1.f;
@@ -403,7 +656,6 @@ void App::handleInput()
                     {
                         l->a = dragAStart[i] + delta;
                         l->b = dragBStart[i] + delta;
-                        l->dirty = true;
                     }
                 }
             }
@@ -411,8 +663,8 @@ void App::handleInput()
             {
                 if (auto* l = findLine(doc, dragId))
                 {
-                    if (dragGrab == Grab::EndA) { l->a = world; l->dirty = true; }
-                    else if (dragGrab == Grab::EndB) { l->b = world; l->dirty = true; }
+                    if (dragGrab == Grab::EndA) { l->a = world; }
+                    else if (dragGrab == Grab::EndB) { l->b = world; }
                 }
             }
         }
@@ -490,7 +742,6 @@ void App::handleInput()
                         {
                             l->a = dragAStart[i];
                             l->b = dragBStart[i];
-                            l->dirty = true;
                         }
                     }
                 }
@@ -508,7 +759,7 @@ void App::handleInput()
                     }
                     else
                     {
-                        l->a = aStart; l->b = bStart; l->dirty = true;
+                        l->a = aStart; l->b = bStart;
                     }
                 }
                 isDragging = false; dragGrab = Grab::None; dragId = 0;
@@ -523,7 +774,7 @@ void App::handleInput()
                 glm::vec2 end = createCurrent;
                 if (glm::length(end - createStart) > 0.5f)
                 {
-                    Line l; l.id = doc.nextId++; l.a = createStart; l.b = end; l.color = uiColor; l.thicknessPx = uiThickness; l.dirty = true;
+                    Line l; l.id = doc.nextId++; l.a = createStart; l.b = end; l.color = uiColor; l.thicknessPx = uiThickness;
                     history.push(std::make_unique<CmdCreateLine>(l), doc);
                     setSingleSelection(doc, l.id);
                 }
@@ -539,7 +790,7 @@ void App::handleInput()
                     Line l;
                     l.id = doc.nextId++;
                     l.a = createStart; l.b = end;
-                    l.color = uiColor; l.thicknessPx = uiThickness; l.dirty = true;
+                    l.color = uiColor; l.thicknessPx = uiThickness;
                     history.push(std::make_unique<CmdCreateLine>(l), doc);
                     polyLineIds.push_back(l.id);
                     setSingleSelection(doc, l.id);
@@ -596,9 +847,11 @@ void App::handleInput()
                         l.a = p0; l.b = p1;
                         l.color = uiColor;
                         l.thicknessPx = uiThickness;
+                        l.rule = uiRule;
+                        l.lsystem = uiLSystem;
                         l.koch2Iters = uiKoch;
                         l.dragonIters = uiDragon;
-                        l.dirty = true;
+                        l.seed = uiSeed;
 
                         newLines.push_back(l);
                         createdIds.push_back(l.id);
@@ -629,7 +882,11 @@ void App::handleInput()
 // Rendering.
 void App::drawScene()
 {
-    rebuildEffectsIfDirty();
+    using Clock = std::chrono::steady_clock;
+    auto ms = [](Clock::time_point from) { return std::chrono::duration<double, std::milli>(Clock::now() - from).count(); };
+
+    const auto effectsStart = Clock::now();
+    updateEffects();
 
     glDisable(GL_DEPTH_TEST);
     glDisable(GL_CULL_FACE);
@@ -639,11 +896,81 @@ void App::drawScene()
     auto VP = viewProj();
     renderer.begin(VP);
 
-    for (auto& l : doc.originals)
+    const float pxPerUnit = viewPixelScale(VP, fbW, fbH);
+    glm::vec2 viewMin, viewMax;
+    viewBounds(viewMin, viewMax);
+
+    placedEffects.update(doc.originals);
+    const CurveSoA& placed = placedEffects.points();
+
+    frameTimings.effects = ms(effectsStart);
+    const auto tessellateStart = Clock::now();
+
+    // While quality is lowered, over-budget lines keep their capped template too.
+    const bool reduced = adaptiveQuality && quality.reduced();
+
+    // Retained and expanded modes: every placed effect keeps its GPU copy; the loop only
+    // picks which to show.
+    const bool retainedMode = effectGeometry == EffectGeometry::Retained;
+    const bool expandedMode = effectGeometry == EffectGeometry::Expanded;
+    std::vector<Renderer2D::RetainedLine> retainedLines(retainedMode ? doc.originals.size() : 0);
+    std::vector<uint8_t> showRetained(retainedLines.size(), 0);
+    std::vector<Renderer2D::ExpandedLine> expandedLines(expandedMode ? doc.originals.size() : 0);
+
+    for (size_t i = 0; i < doc.originals.size(); ++i)
     {
-        renderer.submitPolyline(l.effect.empty() ? std::vector<glm::vec2>{ l.a, l.b } : l.effect, l.thicknessPx, l.color);
+        const Line& l = doc.originals[i];
+        const EffectBatch::Range& r = placedEffects.ranges()[i];
+        if (retainedMode && r.count)
+        {
+            retainedLines[i] = { placed.x.data() + r.first, placed.y.data() + r.first, r.count, r.version, l.thicknessPx, l.color };
+        }
+        if (expandedMode) expandedLines[i] = { r.first, r.count, r.version, l.thicknessPx, l.color, false };
+
+        // Deep zoom: when the per-curve cap would cut the visible depth and the view clips the
+        // curve, draw it past the cap where it meets the view (see DeepZoomCache). A curve the
+        // view shows whole, or whose visible part does not fit, keeps its capped template.
+        // L-system walks have no subtree bound to cull with; they keep their capped template.
+        if (deepZoomCulling && !reduced && !l.lsystem)
+        {
+            int k, d;
+            effectTargetIters(l, pxPerUnit, k, d);
+
+            const TransformDepths capped = predictTransformDepths(l.rule, l.a, l.b, k, d);
+            if (capped.koch2 != k || capped.dragon != d)
+            {
+                glm::vec2 lo, hi;
+                chainBounds(l, l.rule, k, d, lo, hi);
+                if (hi.x < viewMin.x || lo.x > viewMax.x || hi.y < viewMin.y || lo.y > viewMax.y) continue;
+
+                const bool clipped = lo.x < viewMin.x || hi.x > viewMax.x || lo.y < viewMin.y || hi.y > viewMax.y;
+                if (const DeepZoomCache::Effect* e = clipped ? deepZoom.find(l, k, d, capped, viewMin, viewMax) : nullptr)
+                {
+                    for (size_t run = 0; run + 1 < e->runs.size(); ++run)
+                    {
+                        const size_t first = e->runs[run];
+                        renderer.submitRange(e->pts.x.data() + first, e->pts.y.data() + first, e->runs[run + 1] - first, l.thicknessPx, l.color);
+                    }
+                    continue;
+                }
+            }
+        }
+
+        // Off-screen effects are skipped on their chain's analytic bounds.
+        if (r.count && l.effectLSystem == 0 && !chainVisible(l, l.effectRule, l.effectKoch2, l.effectDragon, viewMin, viewMax)) continue;
+        if (r.count && retainedMode) showRetained[i] = 1;
+        else if (r.count && expandedMode) expandedLines[i].shown = true;
+        else if (r.count) renderer.submitRange(placed.x.data() + r.first, placed.y.data() + r.first, r.count, l.thicknessPx, l.color);
+        else renderer.submitSegment(l.a, l.b, l.thicknessPx, l.color);
     }
 
+    deepZoom.prune();
+
+    // With a mode off its buffer is released once.
+    renderer.updateRetained(retainedLines);
+    if (retainedMode) renderer.showRetained(showRetained);
+    renderer.updateExpanded(placed.x.data(), placed.y.data(), expandedMode ? placed.size() : 0, expandedLines);
+
     for (auto& l : doc.originals)
     {
         Color c = l.color; c.a *= 0.35f;
@@ -705,7 +1032,12 @@ void App::drawScene()
         }
     }
 
+    frameTimings.tessellate = ms(tessellateStart);
+
     renderer.end();
+
+    frameTimings.upload = renderer.uploadMs();
+    frameTimings.draw = renderer.drawMs();
 }
 
 // UI.
@@ -750,6 +1082,15 @@ void App::drawUI()
                     clearSelection(doc);
                 }
                 ImGui::SameLine(); ImGui::TextDisabled("(%zu)", doc.selection.size());
+
+                // Lines the scene budget holds below their iterations.
+                for (auto id : doc.selection)
+                {
+                    const Line* l = findLine(doc, id);
+                    if (!l || !l->budgetClamped) continue;
+
+                    ImGui::TextDisabled("Line %llu: %s %d, Dragon %d (budget)", (unsigned long long)l->id, lineRuleName(*l), l->targetKoch2, l->targetDragon);
+                }
             }
             else
             {
@@ -896,13 +1237,78 @@ void App::drawUI()
         {
             ImGui::Text("Transforms");
             ImGui::Separator();
-            ImGui::SliderInt("Koch Type-2", &uiKoch, 0, 6);
-            ImGui::SliderInt("Dragon", &uiDragon, 0, 18);
+            if (ImGui::BeginCombo("Rule", uiLSystem ? uiLSystem->source.name.c_str() : ruleInfo(uiRule).name))
+            {
+                for (int r = 0; r < kCurveRuleCount; ++r)
+                {
+                    if (ImGui::Selectable(ruleInfo(CurveRule(r)).name, !uiLSystem && uiRule == CurveRule(r)))
+                    {
+                        uiRule = CurveRule(r);
+                        uiLSystem = nullptr;
+                    }
+                }
+                for (auto& p : doc.lsystems)
+                {
+                    if (ImGui::Selectable(p->source.name.c_str(), uiLSystem == p)) uiLSystem = p;
+                }
+                ImGui::EndCombo();
+            }
+            const int maxSteps = uiLSystem ? uiLSystem->maxDepth : ruleInfo(uiRule).maxIters;
+            uiKoch = std::min(uiKoch, maxSteps);
+            ImGui::SliderInt("Rule steps", &uiKoch, 0, maxSteps);
+            ImGui::SliderInt("Dragon", &uiDragon, 0, kMaxDragonIters);
+            if (!uiLSystem)
+            {
+                // Each line draws its own variant from the seed and its id.
+                ImGui::InputScalar("Variant seed", ImGuiDataType_U32, &uiSeed);
+                ImGui::SameLine();
+                if (ImGui::Button("Random")) do uiSeed = std::random_device{}(); while (uiSeed == 0);
+                ImGui::SameLine(); ImGui::TextDisabled(uiSeed ? "(random flips)" : "(plain)");
+            }
+
+            // Cost before Apply, from the analytic statistics; nothing is expanded. The template
+            // is shared by every line on the chain, the mesh (4 vertices, 6 indices per segment)
+            // is per line.
+            {
+                size_t segments = 0;
+                double length = 0.0;
+                TransformDepths capped;
+                if (uiLSystem)
+                {
+                    segments = uiLSystem->pointCount(uiKoch) - 1;
+                    for (int d = 0; d < uiDragon; ++d) segments = segments > SIZE_MAX / 2 ? SIZE_MAX : segments * 2;
+                    length = double(segments) * std::pow(uiLSystem->stepScale, double(uiKoch)) * std::pow(std::sqrt(0.5), double(uiDragon));
+                    capped = predictTransformDepths(*uiLSystem, uiKoch, uiDragon);
+                }
+                else
+                {
+                    const CurveStats& st = chainStats(uiRule, uiKoch, uiDragon);
+                    segments = st.segments;
+                    length = st.length;
+                    capped = predictTransformDepths(uiRule, { 0.f, 0.f }, { 1.f, 0.f }, uiKoch, uiDragon);
+                }
+
+                const double mb = 1.0 / (1024.0 * 1024.0);
+                // GPU bytes of the current effect geometry: a quad per segment with 16-bit
+                // (streamed) or 32-bit (retained) indices, or x, y and line index per point.
+                double meshBytes = 0.0;
+                switch (effectGeometry)
+                {
+                case EffectGeometry::Immediate: meshBytes = double(segments) * (4.0 * sizeof(Vertex) + 6.0 * sizeof(uint16_t)); break;
+                case EffectGeometry::Retained: meshBytes = double(segments) * (4.0 * sizeof(Vertex) + 6.0 * sizeof(uint32_t)); break;
+                case EffectGeometry::Expanded: meshBytes = double(segments + 1) * (2.0 * sizeof(float) + sizeof(uint32_t)); break;
+                }
+                const size_t lines = std::max<size_t>(doc.selection.size(), 1);
+                ImGui::TextDisabled("%.4g segments, length x%.4g", double(segments), length);
+                ImGui::TextDisabled("Template %.2f MB, mesh %.2f MB x %zu line(s)", double(segments + 1) * sizeof(glm::vec2) * mb, meshBytes * mb, lines);
+                if (capped.points < segments + 1)
+                    ImGui::TextDisabled("Capped to %zu points per line (steps %d, dragon %d); PNG export streams full depth", capped.points, capped.koch2, capped.dragon);
+            }
             if (!doc.selection.empty())
             {
                 if (ImGui::Button("Apply"))
                 {
-                    history.push(std::make_unique<CmdTransformsMany>(doc.selection, uiKoch, uiDragon, doc), doc);
+                    history.push(std::make_unique<CmdTransformsMany>(doc.selection, uiRule, uiLSystem, uiKoch, uiDragon, uiSeed, doc), doc);
                 }
                 ImGui::SameLine(); ImGui::TextDisabled("(%zu)", doc.selection.size());
             }
@@ -910,6 +1316,51 @@ void App::drawUI()
             {
                 ImGui::TextDisabled("Nothing selected.");
             }
+
+            // L-system editor: compiled on Define and added to the Rule list under its name.
+            if (ImGui::CollapsingHeader("L-system"))
+            {
+                static char name[64] = "Koch curve";
+                static char axiom[256] = "F";
+                static char productions[1024] = "F=F+F--F+F\n";
+                static float angleDeg = 60.f;
+                static float stepScale = 1.f / 3.f;
+                static std::string error;
+
+                if (uiLSystem && ImGui::Button("Edit selected rule"))
+                {
+                    const LSystemSource& src = uiLSystem->source;
+                    snprintf(name, sizeof(name), "%s", src.name.c_str());
+                    snprintf(axiom, sizeof(axiom), "%s", src.axiom.c_str());
+                    snprintf(productions, sizeof(productions), "%s", formatLSystemProductions(src.productions).c_str());
+                    angleDeg = src.angleDeg;
+                    stepScale = src.stepScale;
+                }
+
+                ImGui::InputText("Name", name, IM_ARRAYSIZE(name));
+                ImGui::InputText("Axiom", axiom, IM_ARRAYSIZE(axiom));
+                ImGui::InputTextMultiline("Productions", productions, IM_ARRAYSIZE(productions), ImVec2(0, ImGui::GetTextLineHeight() * 5));
+                ImGui::InputFloat("Angle", &angleDeg, 1.f, 15.f, "%.3f deg");
+                ImGui::InputFloat("Step scale", &stepScale, 0.01f, 0.1f, "%.4f");
+                ImGui::TextDisabled("F, G draw; A-Z rewrite; + - turn; | turns around.");
+
+                if (ImGui::Button("Define"))
+                {
+                    LSystemSource src;
+                    src.name = name;
+                    src.axiom = axiom;
+                    src.angleDeg = angleDeg;
+                    src.stepScale = stepScale;
+
+                    if (src.name.empty()) error = "Name the rule";
+                    else if (parseLSystemProductions(productions, src.productions, error))
+                    {
+                        if (auto prog = compileLSystem(src, error)) defineLSystem(std::move(prog));
+                    }
+                }
+                if (!error.empty()) ImGui::TextColored(ImVec4(1.f, 0.4f, 0.4f, 1.f), "%s", error.c_str());
+                else if (uiLSystem) ImGui::TextDisabled("%s: %zu bytes, %zu steps at depth %d", uiLSystem->source.name.c_str(), uiLSystem->code.size(), uiLSystem->pointCount(uiLSystem->maxDepth) - 1, uiLSystem->maxDepth);
+            }
             ImGui::EndTabItem();
         }
 
@@ -918,9 +1369,26 @@ void App::drawUI()
         {
             ImGui::Text("Canvas");
             ImGui::Separator();
-            ImGui::SliderFloat("Zoom", &doc.camZoom, 0.1f, 10.f, "%.2f", ImGuiSliderFlags_AlwaysClamp);
+            ImGui::SliderFloat("Zoom", &doc.camZoom, kMinCamZoom, kMaxCamZoom, "%.2f", ImGuiSliderFlags_AlwaysClamp | ImGuiSliderFlags_Logarithmic);
             ImGui::Text("Center: (%.1f, %.1f)", doc.camCenter.x, doc.camCenter.y);
             ImGui::Separator();
+            ImGui::Checkbox("Background effects", &backgroundEffects);
+            if (size_t busy = effects.inFlight()) { ImGui::SameLine(); ImGui::TextDisabled("(rebuilding %zu)", busy); }
+            ImGui::BeginDisabled(!backgroundEffects);
+            ImGui::Checkbox("Progressive refinement", &progressiveEffects);
+            ImGui::EndDisabled();
+            ImGui::Checkbox("Screen-space LOD", &lodEnabled);
+            ImGui::SliderFloat("LOD tolerance", &lodTolerancePx, 0.25f, 8.f, "%.2f px", ImGuiSliderFlags_AlwaysClamp);
+            ImGui::Checkbox("Deep-zoom culling", &deepZoomCulling);
+            int geometry = int(effectGeometry);
+            if (ImGui::Combo("Effect geometry", &geometry, "Immediate\0Retained quads\0GPU-expanded\0")) effectGeometry = EffectGeometry(geometry);
+            ImGui::Checkbox("Adaptive quality", &adaptiveQuality);
+            ImGui::SliderFloat("Frame target", &targetFrameMs, 4.f, 50.f, "%.0f ms", ImGuiSliderFlags_AlwaysClamp);
+            ImGui::TextDisabled("effects %.1f, tessellate %.1f, upload %.1f, draw %.1f ms", frameTimings.effects, frameTimings.tessellate, frameTimings.upload, frameTimings.draw);
+            if (adaptiveQuality && quality.reduced()) ImGui::TextDisabled("Quality at %.0f%% while interacting", quality.budgetScale() * 100.f);
+            ImGui::SliderInt("Scene budget", &sceneBudgetK, 100, 20000, "%dK points", ImGuiSliderFlags_AlwaysClamp);
+            ImGui::TextDisabled("%zuK points used, %zu line(s) clamped", (sceneBudgetUsed + 999) / 1000, linesBudgetClamped);
+            ImGui::Separator();
             ImGui::Text("Undo/Redo");
             if (ImGui::Button("Undo##canvas")) history.undo(doc);
             ImGui::SameLine();
@@ -932,6 +1400,7 @@ void App::drawUI()
         if (ImGui::BeginTabItem("Export"))
         {
             static int outW = 1920, outH = 1080;
+            static bool exportLod = false;
             static char base[128];
             static bool initBase = false;
 
@@ -939,6 +1408,7 @@ void App::drawUI()
             if (ImGui::InputInt("Width", &outW)) {}
             if (ImGui::InputInt("Height", &outH)) {}
             if (ImGui::InputText("Base", base, IM_ARRAYSIZE(base))) { exportBase = base; }
+            ImGui::Checkbox("LOD at export resolution", &exportLod);
 
             const auto imgDir = ensureOutputDir("output/images");
             const auto saveDir = ensureOutputDir("output/saves");
@@ -947,7 +1417,7 @@ void App::drawUI()
 
             if (ImGui::Button("Save PNG"))
             {
-                if (!saveCanvasPNG(renderer, doc, outW, outH, pngPath.string()))
+                if (!saveCanvasPNG(renderer, doc, outW, outH, pngPath.string(), exportLod ? lodTolerancePx : 0.f))
                     std::cerr << "PNG save failed: " << pngPath.string() << "\n";
                 else
                     std::cout << "Saved: " << pngPath.string() << "\n";
@@ -971,6 +1441,7 @@ void App::drawUI()
                     std::cerr << "State load failed: " << jsonPath.string() << "\n";
                 else
                     std::cout << "Loaded: " << jsonPath.string() << "\n";
+                uiLSystem = nullptr;
             }
 
             ImGui::TextDisabled("Images: %s", imgDir.string().c_str());
@@ -998,11 +1469,18 @@ void App::run()
         drawUI();
         handleInput();
 
+        // Dragging, creating, UI widgets held down and camera moves count as interaction.
+        const bool interacting = isDragging || creating || ImGui::IsAnyItemActive()
+            || doc.camZoom != lastCamZoom || doc.camCenter != lastCamCenter;
+        lastCamZoom = doc.camZoom;
+        lastCamCenter = doc.camCenter;
+
         glViewport(0, 0, fbW, fbH);
 
         glClearColor(0.12f, 0.12f, 0.125f, 1.f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         drawScene();
+        quality.update(frameTimings, interacting, glfwGetTime(), targetFrameMs);
 
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
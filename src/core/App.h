@@ -7,6 +7,22 @@
 #include "../render/Renderer2D.h"
 #include "../render/Model.h"
 #include "../util/Commands.h"
+#include "EffectCache.h"
+#include "EffectBatch.h"
+#include "DeepZoomCache.h"
+#include "FrameQuality.h"
+
+// Progressive refinement: the first template shown holds at most this many points, and
+// later steps add one rule level or this many dragon folds.
+inline constexpr size_t kProgressiveCoarsePoints = 1 << 10;
+inline constexpr int kProgressiveFolds = 2;
+
+// Camera zoom range (pixels per world unit). World coordinates are floats and the view
+// transform scales them before subtracting the center, so a point r units from the origin
+// lands with about r * zoom * 2^-24 pixels of error: at 4096x a canvas spanning +-1000 units
+// still places vertices within a quarter pixel. Deeper zoom would only show float jitter.
+inline constexpr float kMinCamZoom = 0.1f;
+inline constexpr float kMaxCamZoom = 4096.f;
 
 class App
 {
@@ -22,6 +38,28 @@ private:
     Renderer2D renderer;
     Document doc;
     History history;
+    EffectCache effects;
+    EffectBatch placedEffects; // World-space effect points, re-placed only for dirty lines.
+    DeepZoomCache deepZoom; // Over-budget lines expanded past the cap inside the view.
+    std::unordered_map<uint64_t, CurveStats> statsMemo; // curveStats by chain.
+    bool backgroundEffects{ true }; // Build effect templates off the UI thread.
+    bool progressiveEffects{ true }; // Show coarse levels at once, then step towards the target.
+    // How placed effects reach the GPU: tessellated every frame, kept as quads and
+    // re-tessellated per changed line, or kept as points and expanded by the vertex shader.
+    enum class EffectGeometry { Immediate, Retained, Expanded };
+    EffectGeometry effectGeometry{ EffectGeometry::Expanded };
+    bool lodEnabled{ true }; // Screen-space LOD for effects.
+    float lodTolerancePx{ 1.f }; // Stop subdividing below this projected length.
+    bool deepZoomCulling{ true }; // Expand over-budget lines live, only inside the view.
+    int sceneBudgetK{ 4000 }; // Effect points for the whole document, in thousands.
+    size_t sceneBudgetUsed{ 0 };
+    size_t linesBudgetClamped{ 0 };
+    bool adaptiveQuality{ true }; // Lower the budget while interacting to hold the frame target.
+    float targetFrameMs{ 16.f };
+    FrameQuality quality;
+    FrameTimings frameTimings;
+    float lastCamZoom{ 0.f };
+    glm::vec2 lastCamCenter{};
 
     // Creation state.
     bool creating{ false };
@@ -66,8 +104,11 @@ private:
     // Style UI cache.
     Color uiColor{ 1,1,1,1 };
     float uiThickness{ 3.f };
+    CurveRule uiRule{ CurveRule::Koch2 };
+    std::shared_ptr<const LSystemProgram> uiLSystem; // Replaces uiRule when set.
     int uiKoch{ 0 };
     int uiDragon{ 0 };
+    uint32_t uiSeed{ 0 }; // Random variant seed; 0 for the plain chain.
 
     // Export.
     std::string exportBase{ "canvas" };
@@ -78,8 +119,15 @@ private:
     glm::mat4 viewProj() const;
     glm::vec2 screenToWorld(double sx, double sy) const;
     glm::vec2 worldToScreen(const glm::vec2& p) const;
-    void updateEffect(Line& l);
-    void rebuildEffectsIfDirty();
+    void viewBounds(glm::vec2& lo, glm::vec2& hi) const;
+    void effectTargetIters(const Line& l, float pxPerUnit, int& koch2Iters, int& dragonIters) const;
+    void allocateEffectBudget(float pxPerUnit);
+    void updateEffects();
+    EffectKey refineStep(const Line& l, const EffectKey& target) const;
+    void defineLSystem(std::shared_ptr<const LSystemProgram> prog);
+    const CurveStats& chainStats(CurveRule rule, int koch2Iters, int dragonIters);
+    void chainBounds(const Line& l, CurveRule rule, int koch2Iters, int dragonIters, glm::vec2& lo, glm::vec2& hi);
+    bool chainVisible(const Line& l, CurveRule rule, int koch2Iters, int dragonIters, const glm::vec2& viewMin, const glm::vec2& viewMax);
 
     // Input.
     void handleInput();
@@ -0,0 +1,98 @@
+#include "DeepZoomCache.h"
+#include "../render/Transforms.h"
+#include "../render/Variants.h"
+
+bool DeepZoomCache::stream(const Slot& s, int t, Effect& out)
+{
+    out.koch2 = std::min(t, s.koch2);
+    out.dragon = t - out.koch2;
+    out.pts.x.clear();
+    out.pts.y.clear();
+    out.runs.clear();
+
+    auto sink = [&](const glm::vec2& p, bool startsRun)
+        {
+            if (startsRun) out.runs.push_back(out.pts.size());
+            out.pts.x.push_back(p.x);
+            out.pts.y.push_back(p.y);
+        };
+
+    const bool fits = s.variant
+        ? streamVariantCulled(s.rule, s.variant, s.a, s.b, out.koch2, out.dragon, s.lo, s.hi, s.margin, sink, kMaxCurvePoints)
+        : streamTransformCulled(s.rule, s.a, s.b, out.koch2, out.dragon, s.lo, s.hi, s.margin, sink, kMaxCurvePoints);
+
+    out.runs.push_back(out.pts.size());
+
+    // Every leaf of the chain ends on b at its last step, so a curve that ends inside the
+    // streamed rectangle but not on b was cut off; never show such a stream.
+    const glm::vec2 lo = s.lo - glm::vec2(s.margin), hi = s.hi + glm::vec2(s.margin);
+    const bool endVisible = glm::all(glm::greaterThanEqual(s.b, lo)) && glm::all(glm::lessThanEqual(s.b, hi));
+    if (endVisible && (out.pts.size() == 0 || glm::vec2(out.pts.x.back(), out.pts.y.back()) != s.b)) return false;
+
+    return fits;
+}
+
+const DeepZoomCache::Effect* DeepZoomCache::find(const Line& l, int koch2, int dragon, const TransformDepths& capped,
+    const glm::vec2& viewMin, const glm::vec2& viewMax)
+{
+    Slot& s = slots[l.id];
+    s.used = true;
+
+    // Margin covers the stroke width, so curves just outside the edge still draw their border.
+    const uint64_t variant = lineVariant(l);
+    const glm::vec2 viewSize = viewMax - viewMin;
+    const bool same = s.rule == l.rule && s.variant == variant && s.a == l.a && s.b == l.b && s.koch2 == koch2 && s.dragon == dragon
+        && s.margin == l.thicknessPx && glm::all(glm::greaterThanEqual(viewMin, s.lo)) && glm::all(glm::lessThanEqual(viewMax, s.hi));
+
+    // A depth short of the target (or none at all) was picked for one zoom; zooming in may
+    // let a deeper one fit.
+    const bool reached = s.fits && s.effect.koch2 + s.effect.dragon == koch2 + dragon;
+    if (same && (reached || s.viewSize == viewSize)) return s.fits ? &s.effect : nullptr;
+
+    s.rule = l.rule;
+    s.variant = variant;
+    s.a = l.a;
+    s.b = l.b;
+    s.koch2 = koch2;
+    s.dragon = dragon;
+    s.margin = l.thicknessPx;
+    s.lo = viewMin - kDeepZoomPad * viewSize;
+    s.hi = viewMax + kDeepZoomPad * viewSize;
+    s.viewSize = viewSize;
+
+    // Deepest chain depth in (capped, target] whose visible part fits; more depth means more
+    // visible points, so a binary search over the levels finds it.
+    int fit = capped.koch2 + capped.dragon;
+    int lo = fit + 1, hi = koch2 + dragon;
+    Effect trial;
+    if (stream(s, hi, s.effect))
+    {
+        fit = hi;
+    }
+    else
+    {
+        for (--hi; lo <= hi;)
+        {
+            const int t = (lo + hi) / 2;
+            if (stream(s, t, trial))
+            {
+                fit = t;
+                std::swap(trial, s.effect);
+                lo = t + 1;
+            }
+            else
+            {
+                hi = t - 1;
+            }
+        }
+    }
+
+    s.fits = fit > capped.koch2 + capped.dragon;
+    return s.fits ? &s.effect : nullptr;
+}
+
+void DeepZoomCache::prune()
+{
+    std::erase_if(slots, [](const auto& s) { return !s.second.used; });
+    for (auto& s : slots) s.second.used = false;
+}
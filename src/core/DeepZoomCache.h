@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glm.hpp>
+#include <unordered_map>
+#include <vector>
+#include "../render/Model.h"
+#include "../render/TransformsSimd.h"
+
+// Views are padded by this fraction of their size on every side before streaming, so pans
+// within the padding reuse the points.
+inline constexpr float kDeepZoomPad = 0.25f;
+
+// Deep-zoom effects: lines whose LOD depth the per-curve cap would cut, expanded past the cap
+// only where they meet a padded view (streamTransformCulled). The deepest depth whose visible
+// part fits in kMaxCurvePoints is picked; nothing is ever cut off partway. Points are kept
+// until the line, its target or the view changes enough to need others.
+class DeepZoomCache
+{
+public:
+    // Streamed points; run i is [runs[i], runs[i + 1]) (runs ends with pts.size()).
+    struct Effect
+    {
+        CurveSoA pts;
+        std::vector<size_t> runs;
+        int koch2{ 0 };
+        int dragon{ 0 };
+    };
+
+    // Culled effect of a built-in chain line at target (koch2, dragon) for the view, or null
+    // when no depth past `capped` fits and the capped template should be drawn instead.
+    const Effect* find(const Line& l, int koch2, int dragon, const TransformDepths& capped, const glm::vec2& viewMin, const glm::vec2& viewMax);
+
+    // Drops lines not found since the last call.
+    void prune();
+
+private:
+    struct Slot
+    {
+        CurveRule rule{ CurveRule::Koch2 };
+        uint64_t variant{ 0 };
+        glm::vec2 a{}, b{};
+        int koch2{ 0 }, dragon{ 0 };
+        float margin{ 0.f };
+        glm::vec2 lo{}, hi{}; // Padded view the points cover.
+        glm::vec2 viewSize{}; // View the depth was picked for.
+        bool fits{ false }; // A depth past the cap was found.
+        bool used{ false };
+        Effect effect;
+    };
+
+    // Streams the line at chain depth t (rule levels first, then folds) into `out`; false if
+    // the visible part does not fit.
+    static bool stream(const Slot& s, int t, Effect& out);
+
+    std::unordered_map<Id, Slot> slots;
+};
@@ -0,0 +1,64 @@
+#include "EffectBatch.h"
+#include "../render/Transforms.h"
+#include "../util/ThreadPool.h"
+
+size_t EffectBatch::update(const std::vector<Line>& lines)
+{
+    // Ranges are laid out by template size; any change in the line list or a size moves them.
+    bool relayout = spans.size() != lines.size();
+    for (size_t i = 0; i < lines.size() && !relayout; ++i)
+    {
+        relayout = spans[i].count != (lines[i].effect ? lines[i].effect->size() : 0);
+    }
+
+    if (relayout)
+    {
+        spans.resize(lines.size());
+        placed.assign(lines.size(), Placed{});
+
+        size_t total = 0;
+        for (size_t i = 0; i < lines.size(); ++i)
+        {
+            spans[i] = { total, lines[i].effect ? lines[i].effect->size() : 0, 0 };
+            total += spans[i].count;
+        }
+        pts.resize(total);
+    }
+
+    std::vector<size_t> dirty;
+    for (size_t i = 0; i < lines.size(); ++i)
+    {
+        const Line& l = lines[i];
+        const Placed& p = placed[i];
+        if (l.effect && (p.effect != l.effect || p.a != l.a || p.b != l.b)) dirty.push_back(i);
+    }
+
+    for (size_t i : dirty) spans[i].version = ++placements;
+
+    // Same arithmetic as placeOnSegment, so the points match a per-line placement exactly.
+    float* ox = pts.x.data();
+    float* oy = pts.y.data();
+    sharedThreadPool().parallelFor(dirty.size(), 64, [&](size_t begin, size_t end)
+        {
+            for (size_t j = begin; j < end; ++j)
+            {
+                const size_t i = dirty[j];
+                const Line& l = lines[i];
+                const glm::vec2* unit = l.effect->data();
+                const glm::vec2 d = l.b - l.a;
+                const glm::vec2 n = rot90L(d);
+                float* x = ox + spans[i].first;
+                float* y = oy + spans[i].first;
+
+                for (size_t m = 0; m < spans[i].count; ++m)
+                {
+                    x[m] = l.a.x + unit[m].x * d.x + unit[m].y * n.x;
+                    y[m] = l.a.y + unit[m].x * d.y + unit[m].y * n.y;
+                }
+
+                placed[i] = { l.effect, l.a, l.b };
+            }
+        });
+
+    return dirty.size();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glm.hpp>
+#include <memory>
+#include <vector>
+#include "../render/Model.h"
+#include "../render/TransformsSimd.h"
+
+// World-space points of every line's effect in one flat SoA buffer, line i owning
+// [ranges()[i].first, + count). Lines only share templates, so placing them is the per-line
+// part of expansion; update() re-places just the dirty lines (moved, or holding another
+// template) together in one parallel sweep instead of a placement loop per line per frame.
+class EffectBatch
+{
+public:
+    struct Range
+    {
+        size_t first{ 0 };
+        size_t count{ 0 }; // 0 for a line without a template.
+        uint64_t version{ 0 }; // Changes whenever the points are re-placed.
+    };
+
+    // Brings the buffer in line with `lines` (same order as the document). Returns how many
+    // lines were re-placed.
+    size_t update(const std::vector<Line>& lines);
+
+    const CurveSoA& points() const { return pts; }
+    const std::vector<Range>& ranges() const { return spans; }
+
+private:
+    // What a range was placed from; the template is held so its address stays unique.
+    struct Placed
+    {
+        std::shared_ptr<const std::vector<glm::vec2>> effect;
+        glm::vec2 a{}, b{};
+    };
+
+    std::vector<Range> spans;
+    std::vector<Placed> placed;
+    CurveSoA pts;
+    uint64_t placements{ 0 };
+};
@@ -0,0 +1,385 @@
+#include "EffectCache.h"
+#include "../render/Transforms.h"
+#include "../render/TransformsSimd.h"
+#include "../util/ThreadPool.h"
+
+#include <algorithm>
+#include <functional>
+
+void buildEffect(
+    CurveRule rule,
+    const glm::vec2& a,
+    const glm::vec2& b,
+    int koch2Iters,
+    int dragonIters,
+    std::vector<glm::vec2>& out,
+    const std::atomic<bool>* cancel)
+{
+    // Other rules expand their stage with the rule engine; the folds still run on the SIMD kernels.
+    if (rule != CurveRule::Koch2)
+    {
+        out = iterateTransformSoA(iterateRule(rule, { a, b }, koch2Iters), 0, dragonIters, 200000, detectSimdLevel(), cancel);
+        return;
+    }
+
+    const TransformDepths depths = clampTransformDepths(a, b, koch2Iters, dragonIters);
+
+    // Large curves are generated in independent chunks across all cores.
+    if (depths.points >= kParallelEffectPoints)
+    {
+        generateTransformParallel(a, b, koch2Iters, dragonIters, out, 200000, cancel);
+        return;
+    }
+
+    // Small curves: level-by-level SIMD kernels on SoA buffers.
+    out = iterateTransformSoA({ a, b }, koch2Iters, dragonIters, 200000, detectSimdLevel(), cancel);
+}
+
+void buildLSystemEffect(
+    const LSystemProgram& prog,
+    int depth,
+    int dragonIters,
+    std::vector<glm::vec2>& out,
+    const std::atomic<bool>* cancel)
+{
+    // The step count is known up front, so the expander writes in place.
+    out.resize(prog.pointCount(depth));
+    out[0] = { 0.f, 0.f };
+    glm::vec2* w = out.data() + 1;
+    if (!expandLSystem(prog, depth, [&](const glm::vec2& p) { *w++ = p; }, cancel)) return;
+
+    if (dragonIters > 0) out = iterateTransformSoA(out, 0, dragonIters, SIZE_MAX, detectSimdLevel(), cancel);
+}
+
+EffectKey EffectCache::effective(const EffectKey& k)
+{
+    // Depths past the point budget produce the same curve, so they share a key.
+    if (k.lsystem)
+    {
+        const TransformDepths t = predictTransformDepths(*k.lsystem, k.koch2, k.dragon);
+        return { CurveRule::Koch2, t.koch2, t.dragon, k.lsystem };
+    }
+
+    const TransformDepths t = clampTransformDepths(k.rule, { 0.f, 0.f }, { 1.f, 0.f }, k.koch2, k.dragon);
+    return { k.rule, t.koch2, t.dragon, nullptr, k.variant };
+}
+
+bool EffectCache::isPrefix(const EffectKey& lower, const EffectKey& upper)
+{
+    if (lower.rule != upper.rule || lower.lsystemHash() != upper.lsystemHash() || lower.variant != upper.variant) return false;
+
+    // Rule levels come first, so a rule-only curve nests in every deeper one. L-system
+    // rewrites may move every point, so only their folds nest.
+    return (lower.koch2 == upper.koch2 && lower.dragon <= upper.dragon)
+        || (!lower.lsystem && lower.dragon == 0 && lower.koch2 <= upper.koch2);
+}
+
+size_t EffectCache::pointCount(const EffectKey& k)
+{
+    size_t segs = size_t(1) << k.dragon;
+    if (k.lsystem) return (k.lsystem->pointCount(k.koch2) - 1) * segs + 1;
+
+    for (int i = 0; i < k.koch2; ++i) segs *= ruleInfo(k.rule).children;
+    return segs + 1;
+}
+
+EffectCache::Job EffectCache::plan(const EffectKey& k) const
+{
+    Job job;
+    job.key = k;
+
+    // Deepest cached prefix; continuing from it never repeats a level that is already built.
+    size_t best = 0;
+    for (auto& t : templates)
+    {
+        const Entry& e = t.second;
+        if (e.key == k || !isPrefix(e.key, k) || e.points->size() <= best) continue;
+
+        best = e.points->size();
+        job.base = e.points;
+        job.baseKey = e.key;
+    }
+
+    return job;
+}
+
+// Continues a prefix by ruleSteps rule levels and `folds` dragon folds. Large prefixes are cut
+// into chunks that each start on an even segment, so alternating rules and the fold see the
+// same segment parity as in one pass, and the chunks run across the pool.
+static std::vector<glm::vec2> extendPrefix(const EffectKey& key, const std::vector<glm::vec2>& base, int ruleSteps, int folds, const std::atomic<bool>* cancel)
+{
+    auto extend = [&](const std::vector<glm::vec2>& pts)
+        {
+            // An L-system prefix differs in folds only, so ruleSteps is 0 there.
+            if (key.rule == CurveRule::Koch2 || key.lsystem)
+            {
+                return iterateTransformSoA(pts, ruleSteps, folds, SIZE_MAX, detectSimdLevel(), cancel);
+            }
+            return iterateTransformSoA(iterateRule(key.rule, pts, ruleSteps, SIZE_MAX), 0, folds, SIZE_MAX, detectSimdLevel(), cancel);
+        };
+
+    if (base.size() < 2) return extend(base);
+
+    const size_t segs = base.size() - 1;
+    const size_t chunk = std::max<size_t>(kExtendChunkSegments, (segs / (sharedThreadPool().concurrency() * 4) + 1) & ~size_t(1));
+    if (segs <= chunk) return extend(base);
+
+    const size_t chunks = (segs + chunk - 1) / chunk;
+    std::vector<std::vector<glm::vec2>> parts(chunks);
+    sharedThreadPool().parallelFor(chunks, 1, [&](size_t first, size_t last)
+        {
+            for (size_t c = first; c < last; ++c)
+            {
+                const size_t begin = c * chunk;
+                const size_t end = std::min(segs, begin + chunk);
+                parts[c] = extend(std::vector<glm::vec2>(base.begin() + begin, base.begin() + end + 1));
+            }
+        });
+
+    // Chunks share their end points; keep each one once.
+    size_t total = 1;
+    for (auto& p : parts) total += p.size() - 1;
+
+    std::vector<glm::vec2> out;
+    out.reserve(total);
+    out.push_back(base.front());
+    for (auto& p : parts) out.insert(out.end(), p.begin() + 1, p.end());
+
+    return out;
+}
+
+EffectTemplate EffectCache::make(const Job& job, const std::atomic<bool>* cancel)
+{
+    auto pts = std::make_shared<std::vector<glm::vec2>>();
+
+    if (job.key.variant)
+    {
+        // Variant levels are parallel on their own and continue any cached prefix.
+        const EffectKey& k = job.key;
+        *pts = job.base
+            ? extendVariant(k.rule, k.variant, *job.base, job.baseKey.koch2, job.baseKey.dragon, k.koch2, k.dragon, cancel)
+            : extendVariant(k.rule, k.variant, { { 0.f, 0.f }, { 1.f, 0.f } }, 0, 0, k.koch2, k.dragon, cancel);
+    }
+    else if (job.base)
+    {
+        *pts = extendPrefix(job.key, *job.base, job.key.koch2 - job.baseKey.koch2, job.key.dragon - job.baseKey.dragon, cancel);
+    }
+    else if (job.key.lsystem)
+    {
+        buildLSystemEffect(*job.key.lsystem, job.key.koch2, job.key.dragon, *pts, cancel);
+    }
+    else
+    {
+        buildEffect(job.key.rule, { 0.f, 0.f }, { 1.f, 0.f }, job.key.koch2, job.key.dragon, *pts, cancel);
+    }
+
+    return pts;
+}
+
+EffectTemplate EffectCache::find(const EffectKey& key)
+{
+    const EffectKey k = effective(key);
+
+    auto it = templates.find(pack(k));
+    if (it != templates.end()) return it->second.points;
+
+    // Smallest cached curve this one nests in.
+    const std::vector<glm::vec2>* deeper = nullptr;
+    size_t stride = 0;
+    for (auto& t : templates)
+    {
+        const Entry& e = t.second;
+        if (!isPrefix(k, e.key) || (deeper && e.points->size() >= deeper->size())) continue;
+
+        deeper = e.points.get();
+        stride = (pointCount(e.key) - 1) / (pointCount(k) - 1);
+    }
+
+    if (!deeper) return nullptr;
+
+    auto pts = std::make_shared<std::vector<glm::vec2>>();
+    pts->reserve(pointCount(k));
+    for (size_t i = 0; i < deeper->size(); i += stride) pts->push_back((*deeper)[i]);
+
+    templates[pack(k)] = { k, pts };
+    return pts;
+}
+
+void EffectCache::build(const std::vector<EffectKey>& keys)
+{
+    // Unique missing keys, most expensive first.
+    std::vector<Job> jobs;
+    for (auto& requested : keys)
+    {
+        if (find(requested)) continue;
+
+        const EffectKey k = effective(requested);
+        const bool seen = std::any_of(jobs.begin(), jobs.end(), [&](const Job& j) { return j.key == k; });
+        if (seen) continue;
+
+        jobs.push_back(plan(k));
+    }
+
+    if (jobs.empty()) return;
+
+    std::stable_sort(jobs.begin(), jobs.end(), [](const Job& x, const Job& y)
+        {
+            return pointCount(x.key) > pointCount(y.key);
+        });
+
+    std::vector<EffectTemplate> built(jobs.size());
+    std::vector<std::function<void()>> tasks;
+    tasks.reserve(jobs.size());
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        tasks.push_back([&, i] { built[i] = make(jobs[i], nullptr); });
+    }
+
+    sharedThreadPool().run(std::move(tasks));
+
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        templates[pack(jobs[i].key)] = { jobs[i].key, std::move(built[i]) };
+    }
+}
+
+bool EffectCache::queued(const EffectKey& k) const
+{
+    return std::any_of(pending.begin(), pending.end(), [&](const Job& j) { return j.key == k; })
+        || std::any_of(running.begin(), running.end(), [&](const Job& j) { return j.key == k && !j.cancel->load(); })
+        || std::any_of(done.begin(), done.end(), [&](const Entry& d) { return d.key == k; });
+}
+
+void EffectCache::request(const EffectKey& key)
+{
+    if (find(key)) return;
+
+    const EffectKey k = effective(key);
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        if (stopping.load() || queued(k)) return;
+        if (!worker.joinable()) worker = std::thread([this] { loop(); });
+
+        // The prefix is picked here: the cache map belongs to the UI thread.
+        Job job = plan(k);
+        job.cancel = std::make_shared<std::atomic<bool>>(false);
+        pending.push_back(std::move(job));
+    }
+    cv.notify_one();
+}
+
+void EffectCache::retain(const std::vector<EffectKey>& wanted)
+{
+    std::vector<EffectKey> keep;
+    keep.reserve(wanted.size());
+    for (auto& w : wanted) keep.push_back(effective(w));
+
+    auto unwanted = [&](const Job& j) { return std::find(keep.begin(), keep.end(), j.key) == keep.end(); };
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    std::erase_if(pending, unwanted);
+    for (auto& j : running)
+    {
+        if (unwanted(j)) j.cancel->store(true);
+    }
+}
+
+bool EffectCache::collect()
+{
+    std::vector<Entry> arrived;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        arrived.swap(done);
+    }
+
+    for (auto& r : arrived) templates[pack(r.key)] = std::move(r);
+
+    return !arrived.empty();
+}
+
+size_t EffectCache::inFlight()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return pending.size() + size_t(std::count_if(running.begin(), running.end(), [](const Job& j) { return !j.cancel->load(); }));
+}
+
+void EffectCache::trim(size_t maxPoints)
+{
+    size_t total = 0;
+    for (auto& t : templates) total += t.second.points->size();
+    if (total <= maxPoints) return;
+
+    // Only this map holds an unreferenced template; drop the largest first so the cheap
+    // shallow levels stay around for quick stepping.
+    std::vector<std::pair<size_t, Key>> unused;
+    for (auto& t : templates)
+    {
+        if (t.second.points.use_count() == 1) unused.push_back({ t.second.points->size(), t.first });
+    }
+    std::sort(unused.begin(), unused.end(), [](const auto& x, const auto& y) { return x.first > y.first; });
+
+    for (auto& u : unused)
+    {
+        if (total <= maxPoints) break;
+        total -= u.first;
+        templates.erase(u.second);
+    }
+}
+
+void EffectCache::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping.store(true);
+        pending.clear();
+        for (auto& j : running) j.cancel->store(true);
+    }
+    cv.notify_all();
+
+    if (worker.joinable()) worker.join();
+}
+
+void EffectCache::loop()
+{
+    for (;;)
+    {
+        std::vector<Job> batch;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [&] { return stopping.load() || !pending.empty(); });
+            if (stopping.load()) return;
+
+            batch.swap(pending);
+            running = batch;
+        }
+
+        // Most expensive first, same as the synchronous build.
+        std::stable_sort(batch.begin(), batch.end(), [](const Job& x, const Job& y)
+            {
+                return pointCount(x.key) > pointCount(y.key);
+            });
+
+        std::vector<std::function<void()>> tasks;
+        tasks.reserve(batch.size());
+        for (auto& job : batch)
+        {
+            tasks.push_back([this, &job]
+                {
+                    // Shutdown or retain() cancels builds midway; their output is discarded.
+                    EffectTemplate t = make(job, job.cancel.get());
+
+                    std::lock_guard<std::mutex> lock(mtx);
+                    if (job.cancel->load()) return;
+                    done.push_back({ job.key, std::move(t) });
+                });
+        }
+
+        sharedThreadPool().run(std::move(tasks));
+
+        std::lock_guard<std::mutex> lock(mtx);
+        running.clear();
+    }
+}
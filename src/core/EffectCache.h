@@ -0,0 +1,161 @@
+#pragma once
+
+#include <glm.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "../render/Transforms.h"
+#include "../render/LSystem.h"
+#include "../render/Variants.h"
+
+// Effects at least this many points go through the parallel generator.
+inline constexpr size_t kParallelEffectPoints = 1 << 15;
+
+// Prefixes longer than this many segments are extended in parallel chunks.
+inline constexpr size_t kExtendChunkSegments = 1 << 11;
+
+// Points kept in unreferenced templates before trim() starts dropping them.
+inline constexpr size_t kEffectCachePoints = size_t(1) << 22;
+
+// Builds one line's effect with the engine that suits its size. A set `cancel` flag makes it
+// return early; the output is then unusable.
+void buildEffect(
+    CurveRule rule,
+    const glm::vec2& a,
+    const glm::vec2& b,
+    int koch2Iters,
+    int dragonIters,
+    std::vector<glm::vec2>& out,
+    const std::atomic<bool>* cancel = nullptr);
+
+// Effect of an L-system first stage in its unit frame (see expandLSystem), written straight
+// into `out`, then folded.
+void buildLSystemEffect(
+    const LSystemProgram& prog,
+    int depth,
+    int dragonIters,
+    std::vector<glm::vec2>& out,
+    const std::atomic<bool>* cancel = nullptr);
+
+// Effect of the unit segment (0,0)->(1,0). Every rule and the dragon fold commute with
+// similarities, so lines with the same chain share one template and place it with
+// placeOnSegment.
+using EffectTemplate = std::shared_ptr<const std::vector<glm::vec2>>;
+
+// Transform chain of a template. With an L-system the first stage is its rewrites (`koch2`
+// counts them) and `rule` is ignored; programs compare by hash. A non-zero `variant` is the
+// RNG key of a random variant of a built-in chain (variantKey), private to its line.
+struct EffectKey
+{
+    CurveRule rule{ CurveRule::Koch2 };
+    int koch2{ 0 };
+    int dragon{ 0 };
+    std::shared_ptr<const LSystemProgram> lsystem;
+    uint64_t variant{ 0 };
+
+    uint64_t lsystemHash() const { return lsystem ? lsystem->hash : 0; }
+
+    bool operator==(const EffectKey& o) const
+    {
+        return rule == o.rule && koch2 == o.koch2 && dragon == o.dragon && lsystemHash() == o.lsystemHash() && variant == o.variant;
+    }
+};
+
+// Document-wide template cache keyed by the rule and the budget-clamped iterations. Templates
+// never go stale, so lines only pick one up; moving, rotating or scaling a line costs nothing.
+// Missing templates are built synchronously (build) or on a background thread (request).
+//
+// Levels nest: the curve at depth n is every 2nd (dragon) or every children-th (rule) point of
+// depth n + 1 (L-system rewrites do not nest; their dragon folds do). Stepping back to a
+// shallower template is a strided copy of a deeper one, and stepping up continues from the
+// deepest cached prefix, so no level is ever generated twice.
+class EffectCache
+{
+public:
+    ~EffectCache() { stop(); }
+
+    // Cached template, or one decimated from a deeper cached template; null otherwise.
+    EffectTemplate find(const EffectKey& key);
+
+    // Build every missing template now, the largest first and in parallel.
+    void build(const std::vector<EffectKey>& keys);
+
+    // Queue a missing template for the background thread. Repeated requests are free.
+    void request(const EffectKey& key);
+
+    // Cancel queued and running builds for keys outside `wanted`: queued ones are dropped,
+    // running ones stop at their next check and their output is discarded.
+    void retain(const std::vector<EffectKey>& wanted);
+
+    // Move finished background builds into the cache; true if any arrived.
+    bool collect();
+
+    // Templates queued or being built.
+    size_t inFlight();
+
+    // Drop templates no line references while they hold more than maxPoints points.
+    void trim(size_t maxPoints = kEffectCachePoints);
+
+    void stop();
+
+private:
+    // Packed chain, program hash and variant.
+    struct Key
+    {
+        uint64_t chain;
+        uint64_t lsystem;
+        uint64_t variant;
+
+        bool operator==(const Key&) const = default;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& k) const { return std::hash<uint64_t>()(k.chain ^ (k.lsystem * 0x9E3779B97F4A7C15ull) ^ (k.variant * 0xC2B2AE3D27D4EB4Full)); }
+    };
+
+    struct Entry
+    {
+        EffectKey key;
+        EffectTemplate points;
+    };
+
+    // A template to build, the cached prefix it continues from, if any, and its cancel flag.
+    struct Job
+    {
+        EffectKey key;
+        EffectTemplate base;
+        EffectKey baseKey;
+        std::shared_ptr<std::atomic<bool>> cancel;
+    };
+
+    static Key pack(const EffectKey& k) { return { (uint64_t(uint32_t(k.rule)) << 48) | (uint64_t(uint32_t(k.koch2)) << 24) | uint32_t(k.dragon), k.lsystemHash(), k.variant }; }
+    static EffectKey effective(const EffectKey& k);
+    static bool isPrefix(const EffectKey& lower, const EffectKey& upper);
+    static size_t pointCount(const EffectKey& k);
+    static EffectTemplate make(const Job& job, const std::atomic<bool>* cancel);
+
+    Job plan(const EffectKey& k) const;
+
+    // UI thread only.
+    std::unordered_map<Key, Entry, KeyHash> templates;
+
+    // Shared with the background thread.
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<Job> pending;
+    std::vector<Job> running;
+    std::vector<Entry> done;
+    std::thread worker;
+    std::atomic<bool> stopping{ false };
+
+    bool queued(const EffectKey& k) const;
+    void loop();
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+// Smallest budget scale the controller goes down to.
+inline constexpr float kMinQualityScale = 1.f / 256.f;
+
+// Seconds without interaction before full quality comes back.
+inline constexpr double kQualityIdleSeconds = 0.25;
+
+// CPU milliseconds of the last frame's stages; `draw` is GPU time, read a frame or two late.
+struct FrameTimings
+{
+    double effects{ 0 };    // Budget, template pick-up and placement.
+    double tessellate{ 0 }; // Submitting strokes to the mesh.
+    double upload{ 0 };
+    double draw{ 0 };
+
+    double total() const { return effects + tessellate + upload + draw; }
+};
+
+// Scales the scene point budget so frames land near a target time while the user interacts.
+// Stage cost grows roughly linearly with the points drawn, so the scale follows the ratio of
+// target to smoothed frame time. It is rounded down to a power of two: nested levels make a
+// halving about one dragon fold less, picked up as a strided copy of the cached template,
+// and small wobbles in frame time then cause no template churn. Idle scenes go back to 1.
+class FrameQuality
+{
+public:
+    void update(const FrameTimings& t, bool interacting, double now, double targetMs)
+    {
+        smoothed = frames++ == 0 ? t.total() : smoothed + 0.3 * (t.total() - smoothed);
+
+        if (interacting) lastInteraction = now;
+        if (now - lastInteraction > kQualityIdleSeconds)
+        {
+            scale = 1.f;
+            return;
+        }
+
+        // The frame after a change still shows the old cost; give it time to settle.
+        if (cooldown > 0)
+        {
+            --cooldown;
+            return;
+        }
+
+        const float before = budgetScale();
+        if (smoothed > targetMs)
+        {
+            scale *= float(std::max(0.25, targetMs / smoothed));
+        }
+        else if (smoothed < 0.6 * targetMs)
+        {
+            scale *= 1.25f;
+        }
+        scale = std::clamp(scale, kMinQualityScale, 1.f);
+
+        if (budgetScale() != before) cooldown = 3;
+    }
+
+    // Factor for the scene budget; 1 is full quality.
+    float budgetScale() const { return std::exp2(std::floor(std::log2(scale))); }
+    bool reduced() const { return scale < 1.f; }
+    double smoothedMs() const { return smoothed; }
+
+private:
+    float scale{ 1.f };
+    double smoothed{ 0 };
+    double lastInteraction{ -1e9 };
+    int frames{ 0 };
+    int cooldown{ 0 };
+};
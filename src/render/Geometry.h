@@ -1,26 +1,64 @@
 #pragma once
 
 #include <glm.hpp>
+#include <algorithm>
+#include <cmath>
 #include <vector>
 #include "Types.h"
 
-// Single vertex (position + color RGBA).
+// Single vertex: a point on a stroke's centerline, the unit direction (snorm16) the shader
+// pushes it out along by its style's half thickness, zero for fills, and its style index.
+// Color and thickness live in the style table, so restyling never touches vertices.
 struct Vertex
 {
     glm::vec2 pos;
-    glm::vec4 color;
+    int16_t normal[2];
+    uint32_t style;
 };
 
-// CPU-side mesh buffers.
+// Texels per style in a style table: color, then (half thickness, shown, 0, 0).
+inline constexpr size_t kStyleTexels = 2;
+
+// Snorm16 of a unit vector component, rounded to nearest even like the SIMD conversions.
+inline int16_t packNormal(float v)
+{
+    return int16_t(std::lrint(std::clamp(v, -1.f, 1.f) * 32767.f));
+}
+
+// Immediate geometry streams through chunks of at most this many vertices, so indices fit in
+// 16 bits and no frame needs one contiguous buffer. Quads need 1.5 indices per vertex, discs
+// under 3.
+inline constexpr uint32_t kChunkVertices = 1 << 16;
+inline constexpr uint32_t kChunkIndices = 3 * kChunkVertices;
+
+// Tessellation target: the chunk being written, in place (the renderer points it at mapped
+// GPU memory) with chunk-local 16-bit indices, and the style table all chunks of a frame share.
+// Writers assume room; the renderer checks fits() first.
 struct Mesh
 {
-    std::vector<Vertex> vertices;
-    std::vector<uint32_t> indices;
+    Vertex* vertices{ nullptr };
+    uint16_t* indices{ nullptr };
+    uint32_t vertexCount{ 0 };
+    uint32_t indexCount{ 0 };
+    std::vector<glm::vec4> styles;
 
-    void clear()
+    bool fits(uint32_t v, uint32_t i) const
     {
-        vertices.clear();
-        indices.clear();
+        return vertices && vertexCount + v <= kChunkVertices && indexCount + i <= kChunkIndices;
+    }
+
+    // Index of a shown style; strokes in a row with the same color and thickness share one.
+    uint32_t style(const Color& c, float halfPx)
+    {
+        const glm::vec4 color{ c.r,c.g,c.b,c.a };
+        const glm::vec4 extra{ halfPx, 1.f, 0.f, 0.f };
+        if (styles.empty() || styles[styles.size() - 2] != color || styles.back() != extra)
+        {
+            styles.push_back(color);
+            styles.push_back(extra);
+        }
+
+        return uint32_t(styles.size() / kStyleTexels - 1);
     }
 };
 
@@ -38,40 +76,43 @@ inline void addThickSegment(Mesh& m, const glm::vec2& a, const glm::vec2& b, flo
     if (len <= 1e-6f) return;
 
     glm::vec2 n = perp(d) / len; // Unit normal.
-    glm::vec2 off = n * halfPx; // Half-thickness offset.
-    uint32_t base = (uint32_t)m.vertices.size();
+    const int16_t nx = packNormal(n.x), ny = packNormal(n.y);
+    const uint16_t base = uint16_t(m.vertexCount);
 
-    glm::vec4 col{ c.r,c.g,c.b,c.a };
-    m.vertices.push_back({ a - off, col });
-    m.vertices.push_back({ a + off, col });
-    m.vertices.push_back({ b + off, col });
-    m.vertices.push_back({ b - off, col });
+    const uint32_t style = m.style(c, halfPx);
+    Vertex* v = m.vertices + m.vertexCount;
+    v[0] = { a, { int16_t(-nx), int16_t(-ny) }, style };
+    v[1] = { a, { nx, ny }, style };
+    v[2] = { b, { nx, ny }, style };
+    v[3] = { b, { int16_t(-nx), int16_t(-ny) }, style };
+    m.vertexCount += 4;
 
     // Two triangles.
-    m.indices.push_back(base + 0); m.indices.push_back(base + 1); m.indices.push_back(base + 2);
-    m.indices.push_back(base + 0); m.indices.push_back(base + 2); m.indices.push_back(base + 3);
+    uint16_t* idx = m.indices + m.indexCount;
+    idx[0] = base + 0; idx[1] = base + 1; idx[2] = base + 2;
+    idx[3] = base + 0; idx[4] = base + 2; idx[5] = base + 3;
+    m.indexCount += 6;
 }
 
-// Add a small filled circle (n-gon) for endpoint handles.
+// Add a small filled circle (n-gon) for endpoint handles: segments + 2 vertices and
+// 3 * segments indices.
 inline void addDisc(Mesh& m, const glm::vec2& center, float radiusPx, int segments, const Color& c)
 {
-    if (segments < 8) segments = 8;
-
-    uint32_t centerIdx = (uint32_t)m.vertices.size();
-    glm::vec4 col{ c.r,c.g,c.b,c.a };
-    m.vertices.push_back({ center, col });
+    uint16_t centerIdx = uint16_t(m.vertexCount);
+    const uint32_t style = m.style(c, 0.f);
+    m.vertices[m.vertexCount++] = { center, { 0, 0 }, style };
 
     for (int i = 0; i <= segments; ++i)
     {
         float t = (float)i / segments * 6.28318530718f;
         glm::vec2 p = center + glm::vec2(std::cos(t), std::sin(t)) * radiusPx;
-        m.vertices.push_back({ p, col });
+        m.vertices[m.vertexCount++] = { p, { 0, 0 }, style };
     }
 
     for (int i = 1; i <= segments; ++i)
     {
-        m.indices.push_back(centerIdx);
-        m.indices.push_back(centerIdx + i);
-        m.indices.push_back(centerIdx + i + 1);
+        m.indices[m.indexCount++] = centerIdx;
+        m.indices[m.indexCount++] = uint16_t(centerIdx + i);
+        m.indices[m.indexCount++] = uint16_t(centerIdx + i + 1);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,444 @@
+#pragma once
+
+#include <glm.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Transforms.h"
+
+// ----------Runtime L-systems----------
+// A user rule as typed in the UI and stored in the scene file. Symbols are the letters A-Z;
+// F and G draw one step, the others only rewrite. '+' and '-' turn left and right by angleDeg,
+// '|' turns around. Branches ('[', ']') are rejected: an effect is a single polyline.
+struct LSystemSource
+{
+    std::string name;
+    std::string axiom{ "F" };
+    std::vector<std::pair<char, std::string>> productions;
+    float angleDeg{ 90.f };
+    float stepScale{ 1.f }; // Step length after one rewrite, relative to the step before it.
+};
+
+// Productions as edited in the UI: one "X=replacement" per line, blank lines skipped.
+inline bool parseLSystemProductions(const std::string& text, std::vector<std::pair<char, std::string>>& out, std::string& error)
+{
+    out.clear();
+
+    size_t at = 0;
+    while (at <= text.size())
+    {
+        size_t eol = text.find('\n', at);
+        if (eol == std::string::npos) eol = text.size();
+
+        std::string line = text.substr(at, eol - at);
+        at = eol + 1;
+
+        line.erase(std::remove_if(line.begin(), line.end(), [](char c) { return c == ' ' || c == '\t' || c == '\r'; }), line.end());
+        if (line.empty()) continue;
+
+        if (line.size() < 2 || line[1] != '=')
+        {
+            error = "Expected X=... in \"" + line + "\"";
+            return false;
+        }
+        out.push_back({ line[0], line.substr(2) });
+    }
+
+    return true;
+}
+
+inline std::string formatLSystemProductions(const std::vector<std::pair<char, std::string>>& productions)
+{
+    std::string text;
+    for (auto& p : productions) text += std::string(1, p.first) + "=" + p.second + "\n";
+    return text;
+}
+
+// Rewrites past this depth are not supported (the expander's stack is fixed).
+inline constexpr int kMaxLSystemDepth = 24;
+
+// Byte codes: symbols are their letter index, turns follow.
+inline constexpr uint8_t kLSymbolCount = 26;
+inline constexpr uint8_t kLOpLeft = 26;
+inline constexpr uint8_t kLOpRight = 27;
+inline constexpr uint8_t kLOpBack = 28;
+
+// A compiled rule. Immutable once built and shared by every line that uses it; editing a rule
+// compiles a new program, so templates keyed by `hash` never go stale.
+struct LSystemProgram
+{
+    LSystemSource source;
+
+    // Axiom first, then every production, one byte per command.
+    std::vector<uint8_t> code;
+    uint32_t axiomEnd{ 0 };
+    std::array<uint32_t, kLSymbolCount> begin{};
+    std::array<uint32_t, kLSymbolCount> end{};
+    std::array<bool, kLSymbolCount> rewrites{};
+    std::array<bool, kLSymbolCount> draws{};
+
+    // Headings. When 360 / angle is a whole number the turtle's state is an index into
+    // `directions`: `period` headings, then the same headings turned around ('|').
+    double angleRad{ 0.0 };
+    double stepScale{ 1.0 };
+    int period{ 0 };
+    std::vector<glm::dvec2> directions;
+
+    // Last-level blocks (table headings only): for every rewriting symbol and turtle state, the
+    // unit-step offsets its production draws from the entry point and the state it leaves in.
+    // The deepest level holds most of the steps; the expander copies these instead of
+    // interpreting it. Entry i = symbol * 2 * period + state spans blockBegin[i]..blockBegin[i + 1].
+    std::vector<glm::dvec2> blockOffsets;
+    std::vector<uint32_t> blockBegin;
+    std::vector<int> blockExit;
+
+    // Drawn steps after each depth, saturating at SIZE_MAX.
+    std::array<size_t, kMaxLSystemDepth + 1> steps{};
+
+    // Deepest depth that stays a few million steps; bounds the UI slider.
+    int maxDepth{ 0 };
+
+    uint64_t hash{ 0 };
+
+    size_t pointCount(int depth) const { return steps[std::clamp(depth, 0, kMaxLSystemDepth)] + 1; }
+
+    // Heading of the table-free turtle.
+    glm::dvec2 direction(int64_t heading, bool flipped) const
+    {
+        const double t = double(heading) * angleRad;
+        return flipped ? glm::dvec2(-std::cos(t), -std::sin(t)) : glm::dvec2(std::cos(t), std::sin(t));
+    }
+
+    // Table state after a turn command.
+    int turn(int state, uint8_t op) const
+    {
+        const int half = state >= period ? period : 0;
+        const int h = state - half;
+        if (op == kLOpLeft) return half + (h + 1 == period ? 0 : h + 1);
+        if (op == kLOpRight) return half + (h == 0 ? period - 1 : h - 1);
+        return half ? h : state + period;
+    }
+};
+
+// Parses and checks a rule; on failure returns null and says why in `error`.
+inline std::shared_ptr<const LSystemProgram> compileLSystem(const LSystemSource& src, std::string& error)
+{
+    auto prog = std::make_shared<LSystemProgram>();
+    prog->source = src;
+
+    // Appends one command string; whitespace is skipped.
+    auto emit = [&](const std::string& s) -> bool
+        {
+            for (char c : s)
+            {
+                if (c == ' ' || c == '\t' || c == '\r' || c == '\n') continue;
+
+                if (c >= 'A' && c <= 'Z') prog->code.push_back(uint8_t(c - 'A'));
+                else if (c == '+') prog->code.push_back(kLOpLeft);
+                else if (c == '-') prog->code.push_back(kLOpRight);
+                else if (c == '|') prog->code.push_back(kLOpBack);
+                else
+                {
+                    error = std::string("Unsupported command '") + c + "'";
+                    return false;
+                }
+            }
+            return true;
+        };
+
+    if (!emit(src.axiom)) return nullptr;
+    if (prog->code.empty())
+    {
+        error = "Empty axiom";
+        return nullptr;
+    }
+    prog->axiomEnd = uint32_t(prog->code.size());
+
+    for (auto& p : src.productions)
+    {
+        if (p.first < 'A' || p.first > 'Z')
+        {
+            error = std::string("Production for '") + p.first + "': only A-Z rewrite";
+            return nullptr;
+        }
+
+        const int s = p.first - 'A';
+        if (prog->rewrites[s])
+        {
+            error = std::string("Two productions for '") + p.first + "'";
+            return nullptr;
+        }
+
+        prog->rewrites[s] = true;
+        prog->begin[s] = uint32_t(prog->code.size());
+        if (!emit(p.second)) return nullptr;
+        prog->end[s] = uint32_t(prog->code.size());
+    }
+
+    if (!std::isfinite(src.angleDeg) || !std::isfinite(src.stepScale) || src.stepScale <= 0.f)
+    {
+        error = "Angle must be finite and step scale positive";
+        return nullptr;
+    }
+
+    prog->draws['F' - 'A'] = true;
+    prog->draws['G' - 'A'] = true;
+    prog->angleRad = double(src.angleDeg) * 3.14159265358979323846 / 180.0;
+    prog->stepScale = src.stepScale;
+
+    const double turns = 360.0 / double(src.angleDeg);
+    const double rounded = std::round(turns);
+    if (std::isfinite(turns) && rounded >= 1.0 && rounded <= 4096.0 && std::abs(turns - rounded) < 1e-6)
+    {
+        const int p = int(rounded);
+        prog->period = p;
+        prog->directions.resize(size_t(2 * p));
+        for (int h = 0; h < p; ++h)
+        {
+            const double t = 2.0 * 3.14159265358979323846 * h / p;
+            prog->directions[size_t(h)] = { std::cos(t), std::sin(t) };
+            prog->directions[size_t(h + p)] = -prog->directions[size_t(h)];
+        }
+
+        size_t blockSize = 0;
+        for (int s = 0; s < kLSymbolCount; ++s) blockSize += prog->end[s] - prog->begin[s];
+
+        if (blockSize * size_t(2 * p) <= (size_t(1) << 20))
+        {
+            prog->blockBegin.reserve(size_t(kLSymbolCount) * 2 * p + 1);
+            prog->blockExit.reserve(size_t(kLSymbolCount) * 2 * p);
+
+            for (int s = 0; s < kLSymbolCount; ++s)
+            {
+                for (int entry = 0; entry < 2 * p; ++entry)
+                {
+                    prog->blockBegin.push_back(uint32_t(prog->blockOffsets.size()));
+
+                    glm::dvec2 at{ 0.0, 0.0 };
+                    int state = entry;
+                    for (uint32_t i = prog->begin[s]; i < prog->end[s]; ++i)
+                    {
+                        const uint8_t op = prog->code[i];
+                        if (op >= kLSymbolCount) state = prog->turn(state, op);
+                        else if (op == 'F' - 'A' || op == 'G' - 'A')
+                        {
+                            at += prog->directions[size_t(state)];
+                            prog->blockOffsets.push_back(at);
+                        }
+                    }
+                    prog->blockExit.push_back(state);
+                }
+            }
+            prog->blockBegin.push_back(uint32_t(prog->blockOffsets.size()));
+        }
+    }
+
+    // Steps drawn by each symbol after n rewrites: its own step at n = 0 (or when nothing
+    // rewrites it), otherwise the sum over its production.
+    auto add = [](size_t x, size_t y) { return x > SIZE_MAX - y ? SIZE_MAX : x + y; };
+
+    std::array<size_t, kLSymbolCount> perSymbol{};
+    for (int s = 0; s < kLSymbolCount; ++s) perSymbol[s] = prog->draws[s] ? 1 : 0;
+
+    for (int n = 0; n <= kMaxLSystemDepth; ++n)
+    {
+        if (n > 0)
+        {
+            std::array<size_t, kLSymbolCount> next = perSymbol;
+            for (int s = 0; s < kLSymbolCount; ++s)
+            {
+                if (!prog->rewrites[s]) continue;
+
+                size_t sum = 0;
+                for (uint32_t i = prog->begin[s]; i < prog->end[s]; ++i)
+                {
+                    if (prog->code[i] < kLSymbolCount) sum = add(sum, perSymbol[prog->code[i]]);
+                }
+                next[s] = sum;
+            }
+            perSymbol = next;
+        }
+
+        size_t total = 0;
+        for (uint32_t i = 0; i < prog->axiomEnd; ++i)
+        {
+            if (prog->code[i] < kLSymbolCount) total = add(total, perSymbol[prog->code[i]]);
+        }
+        prog->steps[size_t(n)] = total;
+
+        if (total <= (size_t(1) << 23)) prog->maxDepth = n;
+    }
+
+    // FNV-1a over everything that shapes the curve.
+    uint64_t h = 1469598103934665603ull;
+    auto mix = [&](const void* data, size_t n)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                h ^= static_cast<const uint8_t*>(data)[i];
+                h *= 1099511628211ull;
+            }
+        };
+    mix(prog->code.data(), prog->code.size());
+    mix(&prog->axiomEnd, sizeof(prog->axiomEnd));
+    mix(prog->begin.data(), sizeof(prog->begin));
+    mix(prog->end.data(), sizeof(prog->end));
+    mix(prog->rewrites.data(), sizeof(prog->rewrites));
+    mix(&src.angleDeg, sizeof(src.angleDeg));
+    mix(&src.stepScale, sizeof(src.stepScale));
+    prog->hash = h ? h : 1;
+
+    error.clear();
+    return prog;
+}
+
+// Walks the turtle of `depth` rewrites of the axiom without building the rewritten string: an
+// explicit stack holds one read position per depth. The turtle starts at the origin heading +x
+// with steps stepScale^depth long; sink(const glm::vec2&) gets every point after the origin.
+// Returns false if `cancel` was set midway.
+template <class Sink>
+inline bool expandLSystem(const LSystemProgram& prog, int depth, Sink&& sink, const std::atomic<bool>* cancel = nullptr)
+{
+    depth = std::clamp(depth, 0, kMaxLSystemDepth);
+
+    struct Frame { const uint8_t* ip; const uint8_t* end; };
+    Frame stack[kMaxLSystemDepth + 1];
+
+    const uint8_t* code = prog.code.data();
+    stack[0] = { code, code + prog.axiomEnd };
+    int top = 0;
+
+    // Positions add up in double so long walks do not drift.
+    const double step = std::pow(prog.stepScale, double(depth));
+    const bool table = prog.period > 0;
+    const bool blocks = !prog.blockBegin.empty() && depth > 0;
+    glm::dvec2 pos{ 0.0, 0.0 };
+    int state = 0;
+    int64_t heading = 0;
+    bool flipped = false;
+    glm::dvec2 dir = prog.direction(0, false) * step;
+    bool turned = false;
+    size_t drawn = 0;
+
+    while (top >= 0)
+    {
+        Frame& f = stack[top];
+        if (f.ip == f.end)
+        {
+            --top;
+            continue;
+        }
+
+        const uint8_t op = *f.ip++;
+        if (op < kLSymbolCount)
+        {
+            if (top < depth && prog.rewrites[op])
+            {
+                if (!blocks || top + 1 < depth)
+                {
+                    stack[++top] = { code + prog.begin[op], code + prog.end[op] };
+                    continue;
+                }
+
+                // The production would run at the last level: copy its block.
+                const size_t i = size_t(op) * 2 * size_t(prog.period) + size_t(state);
+                const glm::dvec2* o = prog.blockOffsets.data() + prog.blockBegin[i];
+                const glm::dvec2* oe = prog.blockOffsets.data() + prog.blockBegin[i + 1];
+                if (o != oe)
+                {
+                    for (const glm::dvec2* q = o; q != oe; ++q) sink(glm::vec2(pos + *q * step));
+                    pos += oe[-1] * step;
+                    drawn += size_t(oe - o);
+                }
+                state = prog.blockExit[i];
+            }
+            else
+            {
+                if (!prog.draws[op]) continue;
+
+                if (table)
+                {
+                    pos += prog.directions[size_t(state)] * step;
+                }
+                else
+                {
+                    if (turned)
+                    {
+                        dir = prog.direction(heading, flipped) * step;
+                        turned = false;
+                    }
+                    pos += dir;
+                }
+                sink(glm::vec2(pos));
+                ++drawn;
+            }
+
+            if (cancel && drawn >= 0x10000)
+            {
+                if (cancel->load(std::memory_order_relaxed)) return false;
+                drawn = 0;
+            }
+        }
+        else if (table)
+        {
+            state = prog.turn(state, op);
+        }
+        else
+        {
+            if (op == kLOpBack) flipped = !flipped;
+            else heading += op == kLOpLeft ? 1 : -1;
+            turned = true;
+        }
+    }
+
+    return true;
+}
+
+// Predictive clamp for an L-system first stage, with the same level prefixes as
+// predictTransformDepths: cutting a rewrite also drops every dragon fold.
+inline TransformDepths predictTransformDepths(const LSystemProgram& prog, int depth, int dragonIters, size_t maxPoints = kMaxCurvePoints)
+{
+    TransformDepths out;
+    depth = std::clamp(depth, 0, kMaxLSystemDepth);
+
+    while (out.koch2 < depth && prog.pointCount(out.koch2 + 1) <= maxPoints) ++out.koch2;
+
+    size_t segs = prog.pointCount(out.koch2) - 1;
+    if (out.koch2 == depth)
+    {
+        for (int d = 0; d < dragonIters && segs * 2 + 1 <= maxPoints; ++d)
+        {
+            segs *= 2;
+            ++out.dragon;
+        }
+    }
+
+    out.points = segs + 1;
+
+    return out;
+}
+
+// Streaming generator for an L-system line: the unit-frame walk placed on (a, b), each step
+// then folded by the dragon stage. Sink protocol as streamTransform; working memory stays
+// O(depth) whatever maxPoints allows.
+template <class Sink>
+inline void streamLSystem(const LSystemProgram& prog, const glm::vec2& a, const glm::vec2& b, int depth, int dragonIters, size_t maxPoints, Sink&& sink)
+{
+    const TransformDepths depths = predictTransformDepths(prog, depth, dragonIters, maxPoints);
+
+    size_t leaf = 0;
+    glm::vec2 prev = a;
+    sink(a);
+    expandLSystem(prog, depths.koch2, [&](const glm::vec2& p)
+        {
+            const glm::vec2 q = placeOnSegment(p, a, b);
+            streamDragonSegment(prev, q, depths.dragon, (leaf++ & 1) != 0, sink);
+            prev = q;
+        });
+}
@@ -1,11 +1,15 @@
 #pragma once
 
 #include <glm.hpp>
+#include <memory>
 #include <vector>
 #include <optional>
 #include <unordered_map>
 #include <algorithm>
 #include "Types.h"
+#include "Transforms.h"
+#include "LSystem.h"
+#include "Variants.h"
 
 // Tools available in the editor.
 enum class Tool { Select, Line, Poly, RegularPoly };
@@ -18,13 +22,33 @@ struct Line
     Color color{};
     float thicknessPx{ 3.f };
 
-    // Transform chain config per original line.
+    // Transform chain config per original line: koch2Iters steps of `rule`, then dragon folds.
+    CurveRule rule{ CurveRule::Koch2 };
     int koch2Iters{ 0 };
     int dragonIters{ 0 };
 
-    // Effect cache (expanded polyline).
-    bool dirty{ true };
-    std::vector<glm::vec2> effect;
+    // Runtime L-system replacing `rule` as the first stage when set (koch2Iters counts its
+    // rewrites). Shared with Document::lsystems.
+    std::shared_ptr<const LSystemProgram> lsystem;
+
+    // Random variant seed for a built-in chain (see Variants.h); 0 draws the plain curve.
+    uint32_t seed{ 0 };
+
+    // Effect: shared unit-segment template, placed onto (a, b) when drawn. Null until the
+    // first template arrives; a previous template stays in use while a new one builds.
+    std::shared_ptr<const std::vector<glm::vec2>> effect;
+
+    // Iterations after LOD and the scene budget; the held template may still be older.
+    int targetKoch2{ 0 };
+    int targetDragon{ 0 };
+    bool budgetClamped{ false }; // The scene budget (not LOD) cut the target.
+
+    // Chain of the held template.
+    CurveRule effectRule{ CurveRule::Koch2 };
+    uint64_t effectLSystem{ 0 }; // Program hash; 0 for a built-in rule.
+    uint64_t effectVariant{ 0 };
+    int effectKoch2{ 0 };
+    int effectDragon{ 0 };
 
     // Owning group (regular or arbitrary). Resolved during lookups.
     Id groupId{ 0 };
@@ -55,6 +79,9 @@ struct Document
     std::vector<RegularPolyGroup> regPolys;
     std::vector<ArbitraryPolyGroup> arbPolys;
 
+    // User L-systems, compiled. Lines point at these; names are unique.
+    std::vector<std::shared_ptr<const LSystemProgram>> lsystems;
+
     Id nextId{ 1 };
     Id nextGroupId{ 1000000 };
 
@@ -66,6 +93,46 @@ struct Document
 };
 
 // ----------Line Helpers----------
+// RNG key of the line's variant; L-system lines always draw the plain walk.
+inline uint64_t lineVariant(const Line& l)
+{
+    return l.lsystem ? 0 : variantKey(l.seed, l.id);
+}
+
+// True when the held template has the line's rule and the given iterations (endpoints never
+// invalidate it).
+inline bool effectCurrent(const Line& l, int koch2Iters, int dragonIters)
+{
+    const uint64_t lsystem = l.lsystem ? l.lsystem->hash : 0;
+    return l.effect && l.effectRule == l.rule && l.effectLSystem == lsystem && l.effectVariant == lineVariant(l)
+        && l.effectKoch2 == koch2Iters && l.effectDragon == dragonIters;
+}
+
+// Name of the line's first stage.
+inline const char* lineRuleName(const Line& l)
+{
+    return l.lsystem ? l.lsystem->source.name.c_str() : ruleInfo(l.rule).name;
+}
+
+// First-stage child-to-parent length, for LOD.
+inline float lineRuleShrink(const Line& l)
+{
+    return l.lsystem ? std::min(float(l.lsystem->stepScale), 1.f) : ruleInfo(l.rule).shrink;
+}
+
+// Deepest level prefix of the line's chain within maxPoints points.
+inline TransformDepths predictLineDepths(const Line& l, int koch2Iters, int dragonIters, size_t maxPoints = kMaxCurvePoints)
+{
+    if (l.lsystem) return predictTransformDepths(*l.lsystem, koch2Iters, dragonIters, maxPoints);
+    return predictTransformDepths(l.rule, l.a, l.b, koch2Iters, dragonIters, maxPoints);
+}
+
+inline std::shared_ptr<const LSystemProgram> findLSystem(const Document& d, const std::string& name)
+{
+    for (auto& p : d.lsystems) if (p->source.name == name) return p;
+    return nullptr;
+}
+
 inline Line* findLine(Document& d, Id id)
 {
     for (auto& l : d.originals) if (l.id == id) return &l;
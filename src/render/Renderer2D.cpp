@@ -1,7 +1,76 @@
 #include "Renderer2D.h"
+#include "Tessellate.h"
+#include "../util/ThreadPool.h"
 #include <gtc/type_ptr.hpp>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 
+// Vec2 pos, snorm16 normal, uint style, for the VAO bound now.
+static void setVertexLayout()
+{
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, pos));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(Vertex), (const void*)offsetof(Vertex, normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(Vertex), (const void*)offsetof(Vertex, style));
+}
+
+void Renderer2D::destroyStyles(StyleTable& t)
+{
+    if (!t.textures.empty()) glDeleteTextures(GLsizei(t.textures.size()), t.textures.data());
+    if (!t.buffers.empty()) glDeleteBuffers(GLsizei(t.buffers.size()), t.buffers.data());
+    t.textures.clear();
+    t.buffers.clear();
+    t.texels.clear();
+}
+
+void Renderer2D::setStyles(StyleTable& t, const std::vector<glm::vec4>& texels)
+{
+    if (!t.buffers.empty() && texels == t.texels) return;
+
+    const size_t pageTexels = stylesPerPage * kStyleTexels;
+    const size_t pages = std::max<size_t>(1, (texels.size() + pageTexels - 1) / pageTexels);
+    while (t.buffers.size() < pages)
+    {
+        GLuint buffer = 0, texture = 0;
+        glGenBuffers(1, &buffer);
+        glGenTextures(1, &texture);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+        t.buffers.push_back(buffer);
+        t.textures.push_back(texture);
+    }
+
+    // Only pages whose texels differ go up.
+    for (size_t p = 0; p < pages; ++p)
+    {
+        const size_t first = p * pageTexels;
+        const size_t count = std::min(pageTexels, texels.size() - std::min(first, texels.size()));
+        const size_t held = std::min(pageTexels, t.texels.size() - std::min(first, t.texels.size()));
+        if (count == held && std::equal(texels.begin() + first, texels.begin() + first + count, t.texels.begin() + first)) continue;
+
+        glBindBuffer(GL_TEXTURE_BUFFER, t.buffers[p]);
+        if (count == held) glBufferSubData(GL_TEXTURE_BUFFER, 0, count * sizeof(glm::vec4), texels.data() + first);
+        else glBufferData(GL_TEXTURE_BUFFER, count * sizeof(glm::vec4), texels.data() + first, GL_DYNAMIC_DRAW);
+    }
+    t.texels = texels;
+}
+
+void Renderer2D::bindStyles(const StyleTable& t, size_t page, GLint base) const
+{
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, t.textures[page]);
+    glUniform1i(base, GLint(page * stylesPerPage));
+}
+
+void Renderer2D::reserveStyle()
+{
+    if (mesh.styles.size() / kStyleTexels >= stylesPerPage) flush();
+}
+
 bool Renderer2D::init() 
 {
     if (!program.loadFromFiles("basic2d.vert", "basic2d.frag")) 
@@ -11,22 +80,66 @@ bool Renderer2D::init()
         return false;
     }
 
+    // Bound between draws, so no other VAO's element buffer changes by accident.
     glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glGenBuffers(1, &ebo);
     glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
 
-    // Vec2 pos, vec4 color.
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, pos));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, color));
+    glGenVertexArrays(1, &retainedVao);
+    glGenBuffers(1, &retainedVbo);
+    glGenBuffers(1, &retainedEbo);
+    glBindVertexArray(retainedVao);
+    glBindBuffer(GL_ARRAY_BUFFER, retainedVbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, retainedEbo);
+    setVertexLayout();
+
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    stylesPerPage = std::max<size_t>(size_t(maxTexels), 65536) / kStyleTexels;
 
     uVP = glGetUniformLocation(program.id(), "uVP");
+    uStyleBase = glGetUniformLocation(program.id(), "uStyleBase");
+    program.use();
+    glUniform1i(glGetUniformLocation(program.id(), "uStyles"), 0);
+
+    if (!segmentProgram.loadFromFiles("segment2d.vert", "basic2d.frag"))
+    {
+        std::cerr << "Renderer2D failed to load shaders from disk.\n";
+
+        return false;
+    }
+
+    // Instance i reads points i and i + 1: the same buffers at one element further on.
+    glGenVertexArrays(1, &expandedVao);
+    glGenBuffers(1, &expandedX);
+    glGenBuffers(1, &expandedY);
+    glGenBuffers(1, &expandedLine);
+    glBindVertexArray(expandedVao);
+    for (GLuint loc = 0; loc < 4; ++loc)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, loc % 2 ? expandedY : expandedX);
+        glEnableVertexAttribArray(loc);
+        glVertexAttribPointer(loc, 1, GL_FLOAT, GL_FALSE, sizeof(float), (const void*)(loc / 2 * sizeof(float)));
+        glVertexAttribDivisor(loc, 1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, expandedLine);
+    for (GLuint loc = 4; loc < 6; ++loc)
+    {
+        glEnableVertexAttribArray(loc);
+        glVertexAttribIPointer(loc, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (const void*)((loc - 4) * sizeof(uint32_t)));
+        glVertexAttribDivisor(loc, 1);
+    }
+    glBindVertexArray(vao);
+
+    setStyles(expandedStyles, {});
+    setStyles(retainedStyles, {});
+    setStyles(meshStyles, {});
+
+    uSegmentVP = glGetUniformLocation(segmentProgram.id(), "uVP");
+    uSegmentStyleBase = glGetUniformLocation(segmentProgram.id(), "uStyleBase");
+    segmentProgram.use();
+    glUniform1i(glGetUniformLocation(segmentProgram.id(), "uStyles"), 0);
+
+    glGenQueries(2, drawQueries);
 
     return true;
 }
@@ -34,36 +147,215 @@ bool Renderer2D::init()
 void Renderer2D::shutdown() 
 {
     program.destroy();
+    segmentProgram.destroy();
 
-    if (ebo) glDeleteBuffers(1, &ebo), ebo = 0;
-    if (vbo) glDeleteBuffers(1, &vbo), vbo = 0;
+    if (drawQueries[0]) glDeleteQueries(2, drawQueries), drawQueries[0] = drawQueries[1] = 0;
+    if (retainedEbo) glDeleteBuffers(1, &retainedEbo), retainedEbo = 0;
+    if (retainedVbo) glDeleteBuffers(1, &retainedVbo), retainedVbo = 0;
+    if (retainedVao) glDeleteVertexArrays(1, &retainedVao), retainedVao = 0;
+    retained.clear();
+    destroyStyles(meshStyles);
+    destroyStyles(retainedStyles);
+    destroyStyles(expandedStyles);
+    if (expandedLine) glDeleteBuffers(1, &expandedLine), expandedLine = 0;
+    if (expandedY) glDeleteBuffers(1, &expandedY), expandedY = 0;
+    if (expandedX) glDeleteBuffers(1, &expandedX), expandedX = 0;
+    if (expandedVao) glDeleteVertexArrays(1, &expandedVao), expandedVao = 0;
+    expanded.clear();
+    expandedPages.clear();
+    expandedPoints = 0;
+    expandedShown = false;
+    for (StreamChunk& c : chunks)
+    {
+        glDeleteBuffers(1, &c.ebo);
+        glDeleteBuffers(1, &c.vbo);
+        glDeleteVertexArrays(1, &c.vao);
+    }
+    chunks.clear();
+    usedChunks = 0;
+    mesh = Mesh{};
     if (vao) glDeleteVertexArrays(1, &vao), vao = 0;
 }
 
 void Renderer2D::begin(const glm::mat4& vp) 
 {
     vpMat = vp;
-    mesh.clear();
+    mesh = Mesh{};
+    usedChunks = 0;
+    meshVertices = 0;
+    runCounts.clear();
+    runOffsets.clear();
+    pageRuns.clear();
+    expandedShown = false;
 }
 
 void Renderer2D::submitSegment(const glm::vec2& a, const glm::vec2& b, float thicknessPx, const Color& c) 
 {
+    reserveStyle();
+    if (!reserve(4, 6)) return;
+
+    const uint32_t before = mesh.vertexCount;
     addThickSegment(mesh, a, b, thicknessPx * 0.5f, c);
+    meshVertices += mesh.vertexCount - before;
+    if (flushVertices && meshVertices >= flushVertices) flush();
 }
 
+// Points per batch handed to submitRange by the streaming submitters.
+static constexpr size_t kSubmitBatchPoints = 1 << 12;
+
+// Collects streamed points into SoA batches and tessellates each with submitRange; a batch's
+// last point starts the next, so batches join up.
+class PointBatch
+{
+public:
+    PointBatch(Renderer2D& r, float thicknessPx, const Color& c) : renderer(r), thickness(thicknessPx), color(c)
+    {
+        x.reserve(kSubmitBatchPoints);
+        y.reserve(kSubmitBatchPoints);
+    }
+
+    ~PointBatch() { finish(); }
+
+    // A point that starts a new run is not joined to the one before.
+    void add(const glm::vec2& p, bool startsRun = false)
+    {
+        if (startsRun) finish();
+        if (x.size() == kSubmitBatchPoints)
+        {
+            submit();
+            x.assign(1, x.back());
+            y.assign(1, y.back());
+        }
+
+        x.push_back(p.x);
+        y.push_back(p.y);
+    }
+
+    void finish()
+    {
+        submit();
+        x.clear();
+        y.clear();
+    }
+
+private:
+    void submit()
+    {
+        if (x.size() > 1) renderer.submitRange(x.data(), y.data(), x.size(), thickness, color);
+    }
+
+    Renderer2D& renderer;
+    float thickness;
+    Color color;
+    std::vector<float> x, y;
+};
+
 void Renderer2D::submitPolyline(const std::vector<glm::vec2>& pts, float thicknessPx, const Color& c) 
 {
-    if (pts.size() < 2) return;
+    PointBatch batch(*this, thicknessPx, c);
+    for (const glm::vec2& p : pts) batch.add(p);
+}
+
+void Renderer2D::submitPlaced(const std::vector<glm::vec2>& unitPts, const glm::vec2& a, const glm::vec2& b, float thicknessPx, const Color& c)
+{
+    PointBatch batch(*this, thicknessPx, c);
+    for (const glm::vec2& u : unitPts) batch.add(placeOnSegment(u, a, b));
+}
 
-    for (size_t i = 0; i + 1 < pts.size(); ++i) 
+void Renderer2D::submitRange(const float* x, const float* y, size_t n, float thicknessPx, const Color& c)
+{
+    // A chunk holds at most kTessellateGrain segments, so chunks are the unit of parallelism:
+    // fill as many as the range needs (they stay mapped until upload), then tessellate them
+    // together across the pool.
+    struct Piece
     {
-        submitSegment(pts[i], pts[i + 1], thicknessPx, c);
+        size_t first, segs;
+        uint32_t style, baseVertex;
+        Vertex* vertices;
+        uint16_t* indices;
+    };
+    std::vector<Piece> pieces;
+    reserveStyle();
+
+    auto tessellate = [&]
+        {
+            sharedThreadPool().parallelFor(pieces.size(), 1, [&](size_t begin, size_t end)
+                {
+                    for (size_t k = begin; k < end; ++k)
+                    {
+                        const Piece& p = pieces[k];
+                        tessellatePolyline(x + p.first, y + p.first, p.segs + 1, p.style, p.baseVertex, p.vertices, p.indices);
+                    }
+                });
+            pieces.clear();
+        };
+
+    for (size_t done = 0; done + 1 < n;)
+    {
+        if (!reserve(4, 6)) break;
+
+        const size_t room = std::min((kChunkVertices - mesh.vertexCount) / 4, (kChunkIndices - mesh.indexCount) / 6);
+        const size_t segs = std::min(room, n - 1 - done);
+        pieces.push_back({ done, segs, mesh.style(c, thicknessPx * 0.5f), mesh.vertexCount, mesh.vertices + mesh.vertexCount, mesh.indices + mesh.indexCount });
+
+        mesh.vertexCount += uint32_t(4 * segs);
+        mesh.indexCount += uint32_t(6 * segs);
+        meshVertices += 4 * segs;
+        done += segs;
+        if (flushVertices && meshVertices >= flushVertices)
+        {
+            tessellate();
+            flush();
+        }
     }
+
+    tessellate();
+}
+
+void Renderer2D::submitCurve(CurveRule rule, const glm::vec2& a, const glm::vec2& b, int koch2Iters, int dragonIters, float thicknessPx, const Color& c)
+{
+    // Tessellate points in batches as the generator emits them; nothing is cached.
+    PointBatch batch(*this, thicknessPx, c);
+    streamTransform(rule, a, b, koch2Iters, dragonIters, [&](const glm::vec2& p) { batch.add(p); });
+}
+
+void Renderer2D::submitLSystem(const LSystemProgram& prog, const glm::vec2& a, const glm::vec2& b, int depth, int dragonIters, float thicknessPx, const Color& c, size_t maxPoints)
+{
+    PointBatch batch(*this, thicknessPx, c);
+    streamLSystem(prog, a, b, depth, dragonIters, maxPoints, [&](const glm::vec2& p) { batch.add(p); });
+}
+
+void Renderer2D::submitCurveCulled(CurveRule rule, const glm::vec2& a, const glm::vec2& b, int koch2Iters, int dragonIters,
+    const glm::vec2& viewMin, const glm::vec2& viewMax, float thicknessPx, const Color& c, size_t maxPoints)
+{
+    PointBatch batch(*this, thicknessPx, c);
+
+    // Margin covers the stroke width, so curves just outside the edge still draw their border.
+    streamTransformCulled(rule, a, b, koch2Iters, dragonIters, viewMin, viewMax, thicknessPx, [&](const glm::vec2& p, bool startsRun)
+        {
+            batch.add(p, startsRun);
+        }, maxPoints);
+}
+
+void Renderer2D::submitVariantCulled(CurveRule rule, uint64_t variant, const glm::vec2& a, const glm::vec2& b, int koch2Iters, int dragonIters,
+    const glm::vec2& viewMin, const glm::vec2& viewMax, float thicknessPx, const Color& c, size_t maxPoints)
+{
+    PointBatch batch(*this, thicknessPx, c);
+
+    streamVariantCulled(rule, variant, a, b, koch2Iters, dragonIters, viewMin, viewMax, thicknessPx, [&](const glm::vec2& p, bool startsRun)
+        {
+            batch.add(p, startsRun);
+        }, maxPoints);
 }
 
 void Renderer2D::submitDisc(const glm::vec2& center, float radiusPx, const Color& c, int segs)
 {
+    segs = std::clamp(segs, 8, 1024);
+    reserveStyle();
+    if (!reserve(uint32_t(segs + 2), uint32_t(3 * segs))) return;
+
     addDisc(mesh, center, radiusPx, segs, c);
+    meshVertices += segs + 2;
 }
 
 void Renderer2D::end() 
@@ -71,15 +363,395 @@ void Renderer2D::end()
     program.use();
     glUniformMatrix4fv(uVP, 1, GL_FALSE, glm::value_ptr(vpMat));
 
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(Vertex), mesh.vertices.data(), GL_DYNAMIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(uint32_t), mesh.indices.data(), GL_DYNAMIC_DRAW);
+    const auto t0 = std::chrono::steady_clock::now();
+
+    upload();
+
+    uploadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+    // Two queries in turn: the one not just issued is read only once it is ready, so timing
+    // never stalls the pipeline.
+    const GLuint query = drawQueries[drawFrame & 1];
+    glBeginQuery(GL_TIME_ELAPSED, query);
 
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glDrawElements(GL_TRIANGLES, (GLsizei)mesh.indices.size(), GL_UNSIGNED_INT, 0);
+
+    if (expandedShown && expandedPoints > 1)
+    {
+        segmentProgram.use();
+        glUniformMatrix4fv(uSegmentVP, 1, GL_FALSE, glm::value_ptr(vpMat));
+        glBindVertexArray(expandedVao);
+
+        // One draw per style page over its lines' points. GL 3.3 has no base instance, so
+        // the attributes are pointed at the page's first point instead.
+        for (size_t page = 0; page + 1 < expandedPages.size(); ++page)
+        {
+            const size_t first = expandedPages[page], last = expandedPages[page + 1];
+            if (last - first < 2) continue;
+
+            for (GLuint loc = 0; loc < 4; ++loc)
+            {
+                glBindBuffer(GL_ARRAY_BUFFER, loc % 2 ? expandedY : expandedX);
+                glVertexAttribPointer(loc, 1, GL_FLOAT, GL_FALSE, sizeof(float), (const void*)((first + loc / 2) * sizeof(float)));
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, expandedLine);
+            for (GLuint loc = 4; loc < 6; ++loc)
+            {
+                glVertexAttribIPointer(loc, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (const void*)((first + loc - 4) * sizeof(uint32_t)));
+            }
+
+            bindStyles(expandedStyles, page, uSegmentStyleBase);
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(last - first - 1));
+        }
+        glBindVertexArray(vao);
+        program.use();
+    }
+
+    if (!runCounts.empty())
+    {
+        glBindVertexArray(retainedVao);
+        for (size_t page = 0; page + 1 < pageRuns.size(); ++page)
+        {
+            const size_t first = pageRuns[page], count = pageRuns[page + 1] - first;
+            if (!count) continue;
+
+            bindStyles(retainedStyles, page, uStyleBase);
+            glMultiDrawElements(GL_TRIANGLES, runCounts.data() + first, GL_UNSIGNED_INT, runOffsets.data() + first, GLsizei(count));
+        }
+        glBindVertexArray(vao);
+    }
+
+    drawChunks();
+
+    glEndQuery(GL_TIME_ELAPSED);
+
+    const GLuint previous = drawQueries[++drawFrame & 1];
+    GLint ready = 0;
+    if (drawFrame > 1) glGetQueryObjectiv(previous, GL_QUERY_RESULT_AVAILABLE, &ready);
+    if (ready)
+    {
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(previous, GL_QUERY_RESULT, &ns);
+        drawTime = ns * 1e-6;
+    }
+}
+
+size_t Renderer2D::updateRetained(const std::vector<RetainedLine>& lines)
+{
+    auto segmentsOf = [](const RetainedLine& l) { return l.count > 1 ? l.count - 1 : 0; };
+
+    // Slots are laid out by segment count; any change in the line list or a count moves them.
+    bool relayout = retained.size() != lines.size();
+    for (size_t i = 0; i < lines.size() && !relayout; ++i) relayout = retained[i].segments != segmentsOf(lines[i]);
+
+    if (relayout)
+    {
+        size_t total = 0;
+        retained.assign(lines.size(), RetainedSlot{});
+        for (size_t i = 0; i < lines.size(); ++i)
+        {
+            retained[i].first = total;
+            retained[i].segments = segmentsOf(lines[i]);
+            retained[i].version = ~uint64_t(0);
+            total += retained[i].segments;
+        }
+    }
+
+    // Line i's quads use style i; restyling only changes the table.
+    std::vector<glm::vec4> texels(lines.size() * kStyleTexels);
+    for (size_t i = 0; i < lines.size(); ++i)
+    {
+        const RetainedLine& l = lines[i];
+        texels[kStyleTexels * i] = { l.color.r, l.color.g, l.color.b, l.color.a };
+        texels[kStyleTexels * i + 1] = { l.thicknessPx * 0.5f, 1.f, 0.f, 0.f };
+    }
+    setStyles(retainedStyles, texels);
+
+    std::vector<size_t> dirty;
+    for (size_t i = 0; i < lines.size(); ++i)
+    {
+        if (retained[i].segments && retained[i].version != lines[i].version) dirty.push_back(i);
+    }
+
+    if (dirty.empty())
+    {
+        // Nothing left to keep: free the old allocation.
+        if (relayout)
+        {
+            glBindVertexArray(retainedVao);
+            glBindBuffer(GL_ARRAY_BUFFER, retainedVbo);
+            glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, retainedEbo);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+            glBindVertexArray(vao);
+        }
+        return 0;
+    }
+
+    // Dirty lines are tessellated side by side into staging, in parallel, then uploaded in
+    // runs of neighbouring slots: one call per run instead of one per line. While the pool
+    // works, this (UI) thread runs only staging chunks, not queued template builds.
+    std::vector<size_t> staged(dirty.size() + 1, 0);
+    for (size_t j = 0; j < dirty.size(); ++j) staged[j + 1] = staged[j] + retained[dirty[j]].segments;
+
+    std::vector<Vertex> vertices(staged.back() * 4);
+    std::vector<uint32_t> indices(staged.back() * 6);
+    sharedThreadPool().parallelFor(dirty.size(), 16, [&](size_t begin, size_t end)
+        {
+            for (size_t j = begin; j < end; ++j)
+            {
+                const RetainedLine& l = lines[dirty[j]];
+                const size_t at = staged[j];
+                tessellatePolyline(l.x, l.y, l.count, uint32_t(dirty[j]), uint32_t(retained[dirty[j]].first * 4), vertices.data() + at * 4, indices.data() + at * 6);
+            }
+        });
+
+    glBindVertexArray(retainedVao);
+    glBindBuffer(GL_ARRAY_BUFFER, retainedVbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, retainedEbo);
+
+    if (relayout)
+    {
+        // Every slot is dirty and staged in order.
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+    }
+    else
+    {
+        for (size_t j = 0; j < dirty.size();)
+        {
+            size_t k = j + 1;
+            while (k < dirty.size() && dirty[k] == dirty[k - 1] + 1) ++k;
+
+            const size_t first = retained[dirty[j]].first;
+            const size_t segs = staged[k] - staged[j];
+            glBufferSubData(GL_ARRAY_BUFFER, first * 4 * sizeof(Vertex), segs * 4 * sizeof(Vertex), vertices.data() + staged[j] * 4);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first * 6 * sizeof(uint32_t), segs * 6 * sizeof(uint32_t), indices.data() + staged[j] * 6);
+            j = k;
+        }
+    }
+
+    glBindVertexArray(vao);
+
+    for (size_t i : dirty) retained[i].version = lines[i].version;
+
+    return dirty.size();
+}
+
+void Renderer2D::showRetained(const std::vector<uint8_t>& show)
+{
+    runCounts.clear();
+    runOffsets.clear();
+    pageRuns.assign(1, 0);
+
+    // Neighbouring slots merge into one run within a style page.
+    size_t runEnd = 0;
+    for (size_t i = 0; i < show.size() && i < retained.size(); ++i)
+    {
+        // Line i's style sits on page i / stylesPerPage; runs are in line order.
+        while (i / stylesPerPage >= pageRuns.size()) pageRuns.push_back(runCounts.size());
+        if (!show[i] || !retained[i].segments) continue;
+
+        const size_t first = retained[i].first * 6;
+        const size_t count = retained[i].segments * 6;
+        if (runCounts.size() > pageRuns.back() && runEnd == first)
+        {
+            runCounts.back() += GLsizei(count);
+        }
+        else
+        {
+            runCounts.push_back(GLsizei(count));
+            runOffsets.push_back((const void*)(first * sizeof(uint32_t)));
+        }
+        runEnd = first + count;
+    }
+    pageRuns.push_back(runCounts.size());
 }
 
-void Renderer2D::flush() {}
\ No newline at end of file
+size_t Renderer2D::updateExpanded(const float* x, const float* y, size_t n, const std::vector<ExpandedLine>& lines)
+{
+    // Any change in the line list or a range re-uploads everything, line indices included.
+    bool relayout = expandedPoints != n || expanded.size() != lines.size();
+    for (size_t i = 0; i < lines.size() && !relayout; ++i) relayout = expanded[i].first != lines[i].first || expanded[i].count != lines[i].count;
+
+    size_t uploaded = 0;
+    if (relayout)
+    {
+        // Points no line owns get an index no line has.
+        std::vector<uint32_t> owner(n, ~uint32_t(0));
+        expanded.resize(lines.size());
+        for (size_t i = 0; i < lines.size(); ++i)
+        {
+            expanded[i] = { lines[i].first, lines[i].count, lines[i].version };
+            std::fill_n(owner.begin() + lines[i].first, lines[i].count, uint32_t(i));
+            if (lines[i].count) ++uploaded;
+        }
+        expandedPoints = n;
+
+        glBindBuffer(GL_ARRAY_BUFFER, expandedX);
+        glBufferData(GL_ARRAY_BUFFER, n * sizeof(float), x, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, expandedY);
+        glBufferData(GL_ARRAY_BUFFER, n * sizeof(float), y, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, expandedLine);
+        glBufferData(GL_ARRAY_BUFFER, n * sizeof(uint32_t), owner.data(), GL_STATIC_DRAW);
+    }
+    else
+    {
+        // Re-placed lines upload in runs of neighbouring ranges.
+        for (size_t i = 0; i < lines.size();)
+        {
+            if (!lines[i].count || expanded[i].version == lines[i].version)
+            {
+                ++i;
+                continue;
+            }
+
+            const size_t first = lines[i].first;
+            size_t last = first + lines[i].count;
+            expanded[i].version = lines[i].version;
+            ++uploaded;
+
+            while (++i < lines.size() && lines[i].count && expanded[i].version != lines[i].version && lines[i].first == last)
+            {
+                last += lines[i].count;
+                expanded[i].version = lines[i].version;
+                ++uploaded;
+            }
+
+            glBindBuffer(GL_ARRAY_BUFFER, expandedX);
+            glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(float), (last - first) * sizeof(float), x + first);
+            glBindBuffer(GL_ARRAY_BUFFER, expandedY);
+            glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(float), (last - first) * sizeof(float), y + first);
+        }
+    }
+
+    // Point range of each style page's lines; ranges follow line order.
+    expandedPages.assign(1, 0);
+    for (size_t page = 1; page * stylesPerPage < lines.size(); ++page) expandedPages.push_back(lines[page * stylesPerPage].first);
+    expandedPages.push_back(n);
+
+    // The style table is a few dozen bytes per line; only pages that differ go up.
+    std::vector<glm::vec4> texels(lines.size() * kStyleTexels);
+    expandedShown = false;
+    for (size_t i = 0; i < lines.size(); ++i)
+    {
+        const ExpandedLine& l = lines[i];
+        const bool shown = l.shown && l.count > 1;
+        texels[kStyleTexels * i] = { l.color.r, l.color.g, l.color.b, l.color.a };
+        texels[kStyleTexels * i + 1] = { l.thicknessPx * 0.5f, shown ? 1.f : 0.f, 0.f, 0.f };
+        expandedShown |= shown;
+    }
+    setStyles(expandedStyles, texels);
+
+    return uploaded;
+}
+
+bool Renderer2D::reserve(uint32_t v, uint32_t i)
+{
+    if (mesh.fits(v, i)) return true;
+
+    closeChunk();
+
+    if (usedChunks == chunks.size())
+    {
+        StreamChunk c;
+        glGenVertexArrays(1, &c.vao);
+        glGenBuffers(1, &c.vbo);
+        glGenBuffers(1, &c.ebo);
+        glBindVertexArray(c.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, c.vbo);
+        glBufferData(GL_ARRAY_BUFFER, kChunkVertices * sizeof(Vertex), nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, c.ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, kChunkIndices * sizeof(uint16_t), nullptr, GL_STREAM_DRAW);
+        setVertexLayout();
+        chunks.push_back(c);
+    }
+
+    // Orphan and map; only the written prefix is flushed back when the chunk is unmapped.
+    const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_FLUSH_EXPLICIT_BIT;
+    StreamChunk& c = chunks[usedChunks++];
+    glBindVertexArray(c.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, c.vbo);
+    mesh.vertices = (Vertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, kChunkVertices * sizeof(Vertex), access);
+    mesh.indices = (uint16_t*)glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, kChunkIndices * sizeof(uint16_t), access);
+    glBindVertexArray(vao);
+    mesh.vertexCount = mesh.indexCount = 0;
+
+    if (!mesh.vertices || !mesh.indices)
+    {
+        std::cerr << "Renderer2D failed to map a vertex chunk.\n";
+        glBindVertexArray(c.vao);
+        if (mesh.vertices) glUnmapBuffer(GL_ARRAY_BUFFER);
+        if (mesh.indices) glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+        glBindVertexArray(vao);
+        mesh.vertices = nullptr;
+        mesh.indices = nullptr;
+        --usedChunks;
+        return false;
+    }
+
+    return mesh.fits(v, i);
+}
+
+void Renderer2D::closeChunk()
+{
+    if (!usedChunks || !mesh.vertices) return;
+
+    StreamChunk& c = chunks[usedChunks - 1];
+    c.vertexCount = mesh.vertexCount;
+    c.indexCount = mesh.indexCount;
+    mesh.vertices = nullptr;
+    mesh.indices = nullptr;
+}
+
+void Renderer2D::upload()
+{
+    closeChunk();
+
+    for (size_t k = 0; k < usedChunks; ++k)
+    {
+        const StreamChunk& c = chunks[k];
+        glBindVertexArray(c.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, c.vbo);
+        glFlushMappedBufferRange(GL_ARRAY_BUFFER, 0, c.vertexCount * sizeof(Vertex));
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glFlushMappedBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, c.indexCount * sizeof(uint16_t));
+        glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+    }
+    glBindVertexArray(vao);
+
+    setStyles(meshStyles, mesh.styles);
+}
+
+void Renderer2D::drawChunks()
+{
+    bindStyles(meshStyles, 0, uStyleBase);
+    for (size_t k = 0; k < usedChunks; ++k)
+    {
+        if (!chunks[k].indexCount) continue;
+
+        glBindVertexArray(chunks[k].vao);
+        glDrawElements(GL_TRIANGLES, (GLsizei)chunks[k].indexCount, GL_UNSIGNED_SHORT, 0);
+    }
+    glBindVertexArray(vao);
+}
+
+void Renderer2D::flush()
+{
+    if (!usedChunks) return;
+
+    program.use();
+    glUniformMatrix4fv(uVP, 1, GL_FALSE, glm::value_ptr(vpMat));
+
+    upload();
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    drawChunks();
+
+    // Draw order is submit order, so blending matches one big draw.
+    mesh = Mesh{};
+    usedChunks = 0;
+    meshVertices = 0;
+}
@@ -5,6 +5,9 @@
 #include <vector>
 #include "../util/ShaderProgram.h"
 #include "Geometry.h"
+#include "Transforms.h"
+#include "LSystem.h"
+#include "Variants.h"
 
 class Renderer2D 
 {
@@ -16,14 +19,146 @@ public:
     void begin(const glm::mat4& vp);
     void submitSegment(const glm::vec2& a, const glm::vec2& b, float thicknessPx, const Color& c);
     void submitPolyline(const std::vector<glm::vec2>& pts, float thicknessPx, const Color& c);
+    // Unit-segment template placed onto (a, b).
+    void submitPlaced(const std::vector<glm::vec2>& unitPts, const glm::vec2& a, const glm::vec2& b, float thicknessPx, const Color& c);
+    // Polyline from n points of a SoA buffer.
+    void submitRange(const float* x, const float* y, size_t n, float thicknessPx, const Color& c);
+    void submitCurve(CurveRule rule, const glm::vec2& a, const glm::vec2& b, int koch2Iters, int dragonIters, float thicknessPx, const Color& c);
+    void submitLSystem(const LSystemProgram& prog, const glm::vec2& a, const glm::vec2& b, int depth, int dragonIters, float thicknessPx, const Color& c,
+        size_t maxPoints = kMaxCurvePoints);
+    // Full-depth curve expanded only inside [viewMin, viewMax] (world units).
+    void submitCurveCulled(CurveRule rule, const glm::vec2& a, const glm::vec2& b, int koch2Iters, int dragonIters,
+        const glm::vec2& viewMin, const glm::vec2& viewMax, float thicknessPx, const Color& c, size_t maxPoints = kMaxCurvePoints);
+    // Same for a random variant (see Variants.h).
+    void submitVariantCulled(CurveRule rule, uint64_t variant, const glm::vec2& a, const glm::vec2& b, int koch2Iters, int dragonIters,
+        const glm::vec2& viewMin, const glm::vec2& viewMax, float thicknessPx, const Color& c, size_t maxPoints = kMaxCurvePoints);
     void submitDisc(const glm::vec2& center, float radiusPx, const Color& c, int segs = 20);
     void end();
+
+    // Retained effect geometry: every line's polyline is tessellated into one persistent GPU
+    // buffer and re-tessellated, with a sub-range upload, only when its points (version)
+    // change. Thickness and color sit in a per-line style table, so restyling uploads only
+    // that. A static scene then costs only the draw.
+    struct RetainedLine
+    {
+        const float* x{ nullptr };
+        const float* y{ nullptr };
+        size_t count{ 0 }; // Points; 0 keeps no geometry for the line.
+        uint64_t version{ 0 };
+        float thicknessPx{ 0.f };
+        Color color{};
+    };
+
+    // Brings the buffer in line with `lines`; returns how many lines were re-tessellated.
+    size_t updateRetained(const std::vector<RetainedLine>& lines);
+    // Retained lines drawn by end() this frame (before the mesh), merged into runs.
+    void showRetained(const std::vector<uint8_t>& show);
+
+    // GPU-expanded effect geometry: only the placed points (8 bytes each) and a per-point line
+    // index (4) live on the GPU; segment2d.vert turns each pair of consecutive points of one
+    // line into a quad, with thickness and color from a per-line style table. Points upload
+    // when their line's version changes, styles when any style changes; nothing tessellates.
+    struct ExpandedLine
+    {
+        size_t first{ 0 }; // Range in the point buffer.
+        size_t count{ 0 };
+        uint64_t version{ 0 };
+        float thicknessPx{ 0.f };
+        Color color{};
+        bool shown{ false }; // Drawn by end() this frame (before the mesh); begin() hides all.
+    };
+
+    // Brings the GPU copy of the n points (x, y) in line with `lines`, which own disjoint
+    // ranges of them; returns how many lines' points were uploaded.
+    size_t updateExpanded(const float* x, const float* y, size_t n, const std::vector<ExpandedLine>& lines);
+
+    // Draws what was submitted so far and empties the mesh.
     void flush();
+    // With n > 0 the mesh is flushed whenever it reaches n vertices, so streamed curves of
+    // any size tessellate in bounded memory.
+    void setFlushVertices(size_t n) { flushVertices = n; }
+
+    // Milliseconds of the last unmap of the streamed chunks (CPU) and of a recent draw (GPU).
+    double uploadMs() const { return uploadTime; }
+    double drawMs() const { return drawTime; }
 
 private:
-    GLuint vao{ 0 }, vbo{ 0 }, ebo{ 0 };
+    // One chunk of streamed immediate geometry. The pool is reused every frame; each chunk is
+    // orphaned when mapped, so the driver hands out fresh storage while the GPU may still be
+    // drawing last frame's copy.
+    struct StreamChunk
+    {
+        GLuint vao{ 0 }, vbo{ 0 }, ebo{ 0 };
+        uint32_t vertexCount{ 0 };
+        uint32_t indexCount{ 0 };
+    };
+
+    // Points the mesh at room for v vertices and i indices, mapping the next chunk if the
+    // current one is full; false if no chunk could be mapped.
+    bool reserve(uint32_t v, uint32_t i);
+    void closeChunk();
+    // Unmaps this frame's chunks and uploads the mesh styles.
+    void upload();
+    void drawChunks();
+
+    // Where a retained line's quads sit and what they were built from.
+    struct RetainedSlot
+    {
+        size_t first{ 0 }; // First segment.
+        size_t segments{ 0 };
+        uint64_t version{ 0 };
+    };
+
+    // A style table on the GPU: kStyleTexels RGBA32F texels per style, in pages of
+    // stylesPerPage styles (GL 3.3 only guarantees 65536 texels per texture buffer). The
+    // shaders read one page as uStyles on unit 0, with indices relative to uStyleBase.
+    struct StyleTable
+    {
+        std::vector<GLuint> buffers, textures; // One per page.
+        std::vector<glm::vec4> texels; // What the pages hold.
+    };
+
+    static void destroyStyles(StyleTable& t);
+    // Uploads the pages of `texels` the table does not already hold.
+    void setStyles(StyleTable& t, const std::vector<glm::vec4>& texels);
+    // Binds a page for the program in use, whose uStyleBase is at `base`.
+    void bindStyles(const StyleTable& t, size_t page, GLint base) const;
+    // Flushes before the mesh style table would outgrow its one page.
+    void reserveStyle();
+
+    // What an expanded line's points were uploaded from.
+    struct ExpandedSlot
+    {
+        size_t first{ 0 };
+        size_t count{ 0 };
+        uint64_t version{ 0 };
+    };
+
+    GLuint vao{ 0 };
+    std::vector<StreamChunk> chunks;
+    size_t usedChunks{ 0 }; // Chunks mapped or filled this frame; the last is the mesh's.
+    size_t meshVertices{ 0 }; // Streamed since the last flush.
+    GLuint expandedVao{ 0 }, expandedX{ 0 }, expandedY{ 0 }, expandedLine{ 0 };
+    StyleTable expandedStyles, retainedStyles, meshStyles;
+    size_t stylesPerPage{ 0 };
+    std::vector<ExpandedSlot> expanded;
+    std::vector<size_t> expandedPages; // First point of each style page's lines, then the end.
+    size_t expandedPoints{ 0 };
+    bool expandedShown{ false };
+    ShaderProgram segmentProgram;
+    GLint uSegmentVP{ -1 }, uSegmentStyleBase{ -1 };
+    GLuint retainedVao{ 0 }, retainedVbo{ 0 }, retainedEbo{ 0 };
+    std::vector<RetainedSlot> retained;
+    std::vector<GLsizei> runCounts;
+    std::vector<const void*> runOffsets;
+    std::vector<size_t> pageRuns; // First run of each style page, then the run count.
     ShaderProgram program;
     Mesh mesh;
     glm::mat4 vpMat{ 1.0f };
-    GLint uVP{ -1 };
+    GLint uVP{ -1 }, uStyleBase{ -1 };
+    size_t flushVertices{ 0 };
+    GLuint drawQueries[2]{ 0, 0 };
+    uint64_t drawFrame{ 0 };
+    double uploadTime{ 0 };
+    double drawTime{ 0 };
 };
\ No newline at end of file
@@ -0,0 +1,203 @@
+#include "Tessellate.h"
+#include "../util/ThreadPool.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define TESSELLATE_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+// GCC/Clang need per-function ISA targets; MSVC accepts intrinsics anywhere.
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMD_TARGET(isa)
+#endif
+
+// The SIMD kernels store whole vertices as four 32-bit lanes.
+static_assert(sizeof(Vertex) == 16 && offsetof(Vertex, normal) == 8 && offsetof(Vertex, style) == 12);
+
+// ----------Scalar kernel----------
+// Reference for the SIMD kernels; same expression order.
+static void quadsScalar(const float* x, const float* y, size_t first, size_t last, uint32_t style, Vertex* v)
+{
+    for (size_t i = first; i < last; ++i)
+    {
+        const glm::vec2 a{ x[i], y[i] };
+        const glm::vec2 b{ x[i + 1], y[i + 1] };
+        const glm::vec2 d = b - a;
+        const float len = glm::length(d);
+        const glm::vec2 u = len > 1e-6f ? perp(d) / len : glm::vec2(0.f);
+        const int16_t nx = packNormal(u.x), ny = packNormal(u.y);
+
+        Vertex* q = v + 4 * i;
+        q[0] = { a, { int16_t(-nx), int16_t(-ny) }, style };
+        q[1] = { a, { nx, ny }, style };
+        q[2] = { b, { nx, ny }, style };
+        q[3] = { b, { int16_t(-nx), int16_t(-ny) }, style };
+    }
+}
+
+#if defined(TESSELLATE_SIMD_X86)
+// ----------SSE2 kernels----------
+// Packed snorm16 pair (low: x, high: y) of four unit vectors.
+SIMD_TARGET("sse2")
+static __m128 packNormalsSse2(__m128 ux, __m128 uy)
+{
+    const __m128 scale = _mm_set1_ps(32767.f);
+    const __m128i nx = _mm_cvtps_epi32(_mm_mul_ps(ux, scale));
+    const __m128i ny = _mm_cvtps_epi32(_mm_mul_ps(uy, scale));
+
+    return _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(nx, _mm_set1_epi32(0xFFFF)), _mm_slli_epi32(ny, 16)));
+}
+
+// Four segments' quads from their columns: a transpose per corner turns (x, y, normal, style)
+// columns into one vertex per row.
+SIMD_TARGET("sse2")
+static void storeQuadsSse2(__m128 ax, __m128 ay, __m128 bx, __m128 by, __m128 plus, __m128 minus, __m128 style, float* out)
+{
+    __m128 c[4][4] = {
+        { ax, ay, minus, style },
+        { ax, ay, plus, style },
+        { bx, by, plus, style },
+        { bx, by, minus, style } };
+
+    for (int k = 0; k < 4; ++k)
+    {
+        _MM_TRANSPOSE4_PS(c[k][0], c[k][1], c[k][2], c[k][3]);
+        for (int lane = 0; lane < 4; ++lane) _mm_storeu_ps(out + 16 * lane + 4 * k, c[k][lane]);
+    }
+}
+
+SIMD_TARGET("sse2")
+static void quadsSse2(const float* x, const float* y, size_t segs, uint32_t style, Vertex* v)
+{
+    const __m128 minLen = _mm_set1_ps(1e-6f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 st = _mm_castsi128_ps(_mm_set1_epi32(int(style)));
+
+    size_t i = 0;
+    for (; i + 4 <= segs; i += 4)
+    {
+        const __m128 ax = _mm_loadu_ps(x + i), bx = _mm_loadu_ps(x + i + 1);
+        const __m128 ay = _mm_loadu_ps(y + i), by = _mm_loadu_ps(y + i + 1);
+        const __m128 dx = _mm_sub_ps(bx, ax);
+        const __m128 dy = _mm_sub_ps(by, ay);
+        const __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+        const __m128 live = _mm_cmpgt_ps(len, minLen);
+        const __m128 ux = _mm_and_ps(live, _mm_div_ps(_mm_sub_ps(zero, dy), len));
+        const __m128 uy = _mm_and_ps(live, _mm_div_ps(dx, len));
+
+        storeQuadsSse2(ax, ay, bx, by, packNormalsSse2(ux, uy), packNormalsSse2(_mm_sub_ps(zero, ux), _mm_sub_ps(zero, uy)), st, (float*)(v + 4 * i));
+    }
+
+    quadsScalar(x, y, i, segs, style, v);
+}
+
+// ----------AVX2 kernels----------
+// storeQuadsSse2 in VEX encoding; mixing legacy SSE into AVX code costs a state transition.
+SIMD_TARGET("avx2")
+static void storeQuadsAvx2(__m128 ax, __m128 ay, __m128 bx, __m128 by, __m128 plus, __m128 minus, __m128 style, float* out)
+{
+    __m128 c[4][4] = {
+        { ax, ay, minus, style },
+        { ax, ay, plus, style },
+        { bx, by, plus, style },
+        { bx, by, minus, style } };
+
+    for (int k = 0; k < 4; ++k)
+    {
+        _MM_TRANSPOSE4_PS(c[k][0], c[k][1], c[k][2], c[k][3]);
+        for (int lane = 0; lane < 4; ++lane) _mm_storeu_ps(out + 16 * lane + 4 * k, c[k][lane]);
+    }
+}
+
+SIMD_TARGET("avx2")
+static __m256 packNormalsAvx2(__m256 ux, __m256 uy)
+{
+    const __m256 scale = _mm256_set1_ps(32767.f);
+    const __m256i nx = _mm256_cvtps_epi32(_mm256_mul_ps(ux, scale));
+    const __m256i ny = _mm256_cvtps_epi32(_mm256_mul_ps(uy, scale));
+
+    return _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(nx, _mm256_set1_epi32(0xFFFF)), _mm256_slli_epi32(ny, 16)));
+}
+
+// Eight segments' normals per step, stored as two 4-wide transposes.
+SIMD_TARGET("avx2")
+static void quadsAvx2(const float* x, const float* y, size_t segs, uint32_t style, Vertex* v)
+{
+    const __m256 minLen = _mm256_set1_ps(1e-6f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m128 st = _mm_castsi128_ps(_mm_set1_epi32(int(style)));
+
+    size_t i = 0;
+    for (; i + 8 <= segs; i += 8)
+    {
+        const __m256 ax = _mm256_loadu_ps(x + i), bx = _mm256_loadu_ps(x + i + 1);
+        const __m256 ay = _mm256_loadu_ps(y + i), by = _mm256_loadu_ps(y + i + 1);
+        const __m256 dx = _mm256_sub_ps(bx, ax);
+        const __m256 dy = _mm256_sub_ps(by, ay);
+        const __m256 len = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+        const __m256 live = _mm256_cmp_ps(len, minLen, _CMP_GT_OQ);
+        const __m256 ux = _mm256_and_ps(live, _mm256_div_ps(_mm256_sub_ps(zero, dy), len));
+        const __m256 uy = _mm256_and_ps(live, _mm256_div_ps(dx, len));
+        const __m256 plus = packNormalsAvx2(ux, uy);
+        const __m256 minus = packNormalsAvx2(_mm256_sub_ps(zero, ux), _mm256_sub_ps(zero, uy));
+
+        float* out = (float*)(v + 4 * i);
+        storeQuadsAvx2(_mm256_castps256_ps128(ax), _mm256_castps256_ps128(ay), _mm256_castps256_ps128(bx), _mm256_castps256_ps128(by),
+            _mm256_castps256_ps128(plus), _mm256_castps256_ps128(minus), st, out);
+        storeQuadsAvx2(_mm256_extractf128_ps(ax, 1), _mm256_extractf128_ps(ay, 1), _mm256_extractf128_ps(bx, 1), _mm256_extractf128_ps(by, 1),
+            _mm256_extractf128_ps(plus, 1), _mm256_extractf128_ps(minus, 1), st, out + 64);
+    }
+
+    quadsScalar(x, y, i, segs, style, v);
+}
+#endif
+
+// Two triangles per quad; plain stores the compiler vectorizes.
+template <class Index>
+static void quadIndices(size_t segs, uint32_t baseVertex, Index* idx)
+{
+    for (size_t i = 0; i < segs; ++i)
+    {
+        const Index base = Index(baseVertex + 4 * i);
+        Index* t = idx + 6 * i;
+        t[0] = base + 0; t[1] = base + 1; t[2] = base + 2;
+        t[3] = base + 0; t[4] = base + 2; t[5] = base + 3;
+    }
+}
+
+// Dispatch.
+static void quads(const float* x, const float* y, size_t segs, uint32_t style, Vertex* v, SimdLevel level)
+{
+#if defined(TESSELLATE_SIMD_X86)
+    if (level == SimdLevel::AVX2) { quadsAvx2(x, y, segs, style, v); return; }
+    if (level == SimdLevel::SSE2) { quadsSse2(x, y, segs, style, v); return; }
+#endif
+    (void)level;
+
+    quadsScalar(x, y, 0, segs, style, v);
+}
+
+template <class Index>
+static void tessellate(const float* x, const float* y, size_t n, uint32_t style, uint32_t baseVertex, Vertex* v, Index* idx, SimdLevel level)
+{
+    if (n < 2) return;
+
+    // A chunk needs only its first segment's offsets, so any split writes the same output.
+    sharedThreadPool().parallelFor(n - 1, kTessellateGrain, [&](size_t first, size_t last)
+        {
+            quads(x + first, y + first, last - first, style, v + 4 * first, level);
+            quadIndices(last - first, baseVertex + uint32_t(4 * first), idx + 6 * first);
+        });
+}
+
+void tessellatePolyline(const float* x, const float* y, size_t n, uint32_t style, uint32_t baseVertex, Vertex* v, uint32_t* idx, SimdLevel level)
+{
+    tessellate(x, y, n, style, baseVertex, v, idx, level);
+}
+
+void tessellatePolyline(const float* x, const float* y, size_t n, uint32_t style, uint32_t baseVertex, Vertex* v, uint16_t* idx, SimdLevel level)
+{
+    tessellate(x, y, n, style, baseVertex, v, idx, level);
+}
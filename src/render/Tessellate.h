@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "Geometry.h"
+#include "TransformsSimd.h"
+
+// Segments per parallel chunk of a batched tessellation.
+inline constexpr size_t kTessellateGrain = 1 << 14;
+
+// Thick quads for the n - 1 segments of the SoA polyline (x, y): segment i writes v[4i..4i+3]
+// and idx[6i..6i+5], indexed from baseVertex, so the output size is known up front. Each
+// quad is the centerline corners a, a, b, b with normal -u, u, u, -u (u = perp(d) / |d|) and
+// the given style. A zero-length segment gets u = 0, a degenerate quad that rasterizes
+// nothing (addThickSegment skips it instead): the fixed 4 + 6 per segment is what lets any
+// split write the same output. Normals are computed four or eight segments at a time;
+// polylines longer than kTessellateGrain segments are split across the shared pool into
+// disjoint output ranges. A streamed chunk holds no more than that, so submitRange runs its
+// chunks in parallel instead. A UI-thread caller helps only with those tasks, never with
+// queued background effect builds.
+void tessellatePolyline(const float* x, const float* y, size_t n, uint32_t style, uint32_t baseVertex, Vertex* v, uint32_t* idx,
+    SimdLevel level = detectSimdLevel());
+
+// Same with 16-bit indices, for streamed chunks; baseVertex + 4 (n - 1) must fit.
+void tessellatePolyline(const float* x, const float* y, size_t n, uint32_t style, uint32_t baseVertex, Vertex* v, uint16_t* idx,
+    SimdLevel level = detectSimdLevel());
@@ -3,6 +3,14 @@
 #include <glm.hpp>
 #include <vector>
 #include <cmath>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include "../util/ThreadPool.h"
 
 // 90 degree helpers.
 inline glm::vec2 rot90L(const glm::vec2& v)
@@ -15,18 +23,80 @@ inline glm::vec2 rot90R(const glm::vec2& v)
     return { v.y, -v.x };
 }
 
-// Quadratic type-2 Koch.
-inline std::vector<glm::vec2> applyKoch2Once(const std::vector<glm::vec2>& in)
+// ----------Substitution rules----------
+// A rule replaces every segment p -> q by the polyline through its stencil points. Point k sits
+// at p + f * (u[k] * s) + n * (v[k] * s), where f is the unit direction, n its left normal and
+// s = |q - p| / scale. The first point is (0, 0) and the last (scale, 0), so they land on p and
+// q. With `alternate`, even segments (index 0, 2, ...) use the stencil mirrored across the
+// segment, as the dragon fold does.
+template <size_t N>
+struct SubstitutionRule
 {
-    if (in.size() < 2) return in;
+    const char* name;
+    float u[N];
+    float v[N];
+    float scale;
+    bool alternate;
+};
+
+template <size_t N>
+constexpr bool ruleEndsOnSegment(const SubstitutionRule<N>& r)
+{
+    return N >= 2 && r.u[0] == 0 && r.v[0] == 0 && r.u[N - 1] == r.scale && r.v[N - 1] == 0;
+}
+
+// Quadratic type-2 Koch (the Minkowski sausage) in quarter steps.
+inline constexpr SubstitutionRule<9> kKoch2Rule{ "Koch type 2", { 0,1,1,2,2,2,3,3,4 }, { 0,0,1,1,0,-1,-1,0,0 }, 4.f, false };
+
+// Koch snowflake edge: thirds with an equilateral bump.
+inline constexpr SubstitutionRule<5> kSnowflakeRule{ "Koch snowflake", { 0,1,1.5f,2,3 }, { 0,0,0.8660254f,0,0 }, 3.f, false };
+
+// Cesaro: the Koch bump at 85 degrees; four equal sides of 1 / (2 + 2 cos 85).
+inline constexpr SubstitutionRule<5> kCesaroRule{ "Cesaro", { 0,0.4599067f,0.5f,0.5400933f,1 }, { 0,0,0.4581567f,0,0 }, 1.f, false };
+
+// Levy C: a right-angle tent on every segment.
+inline constexpr SubstitutionRule<3> kLevyCRule{ "Levy C", { 0,1,2 }, { 0,1,0 }, 2.f, false };
+
+// Peano: nine thirds that double back across the middle.
+inline constexpr SubstitutionRule<10> kPeanoRule{ "Peano", { 0,1,1,2,2,1,1,2,2,3 }, { 0,0,1,1,0,0,-1,-1,0,0 }, 3.f, false };
 
-    static const int U[9] = { 0,1,1,2,2,2,3,3,4 };
-    static const int V[9] = { 0,0,1,1,0,-1,-1,0,0 };
+// Heighway dragon: the Levy tent, flipped on every other segment.
+inline constexpr SubstitutionRule<3> kDragonRule{ "Heighway dragon", { 0,1,2 }, { 0,1,0 }, 2.f, true };
 
-    auto rot90L = [](const glm::vec2& v) { return glm::vec2(-v.y, v.x); };
+static_assert(ruleEndsOnSegment(kKoch2Rule) && ruleEndsOnSegment(kSnowflakeRule) && ruleEndsOnSegment(kCesaroRule));
+static_assert(ruleEndsOnSegment(kLevyCRule) && ruleEndsOnSegment(kPeanoRule) && ruleEndsOnSegment(kDragonRule));
+
+// Stencil points of one step over a non-degenerate (p, q); the stencil is unrolled at compile
+// time. anchors[0] is p and the last anchor is q, exactly.
+template <const auto& R>
+inline void ruleAnchors(const glm::vec2& p, const glm::vec2& q, bool mirrored, glm::vec2* anchors)
+{
+    constexpr size_t N = std::size(R.u);
+
+    const glm::vec2 d = q - p;
+    const float L = glm::length(d);
+    const glm::vec2 f = d / L; // Forward.
+    const glm::vec2 n = mirrored ? rot90R(f) : rot90L(f); // Left-normal (right when mirrored).
+    const float s = L / R.scale; // Stencil unit.
+
+    anchors[0] = p;
+    [&]<size_t... K>(std::index_sequence<K...>)
+    {
+        ((anchors[K + 1] = p + f * (R.u[K + 1] * s) + n * (R.v[K + 1] * s)), ...);
+    }(std::make_index_sequence<N - 2>{});
+    anchors[N - 1] = q;
+}
+
+// One substitution step over a polyline. Zero-length segments stay single segments.
+template <const auto& R>
+inline std::vector<glm::vec2> applyRuleOnce(const std::vector<glm::vec2>& in)
+{
+    constexpr size_t N = std::size(R.u);
+
+    if (in.size() < 2) return in;
 
     std::vector<glm::vec2> out;
-    out.reserve(in.size() * 9);
+    out.reserve(in.size() * N);
     out.push_back(in.front());
 
     for (size_t i = 0; i + 1 < in.size(); ++i)
@@ -34,29 +104,90 @@ inline std::vector<glm::vec2> applyKoch2Once(const std::vector<glm::vec2>& in)
         const glm::vec2 p = in[i];
         const glm::vec2 q = in[i + 1];
 
-        const glm::vec2 d = q - p;
-        const float L = glm::length(d);
-
-        if (L <= 0.0f)
+        if (glm::length(q - p) <= 0.0f)
         {
             out.push_back(q);
             continue;
         }
 
-        const glm::vec2 f = d / L; // Forward.
-        const glm::vec2 n = rot90L(f); // Left-normal.
-        const float s = L * 0.25f; // Quarter step.
+        glm::vec2 anchors[N];
+        ruleAnchors<R>(p, q, R.alternate && (i & 1) == 0, anchors);
+        out.insert(out.end(), anchors + 1, anchors + N);
+    }
 
-        // Emit interior anchors (1..7), then snap last to q.
-        for (int k = 1; k <= 7; ++k)
-        {
-            out.push_back(p + f * (U[k] * s) + n * (V[k] * s));
-        }
+    return out;
+}
+
+// Rules a line's first stage can use. Saved by name, so the order is free to change.
+enum class CurveRule : int { Koch2, Snowflake, Cesaro, LevyC, Peano, Dragon };
+inline constexpr int kCurveRuleCount = 6;
 
-        out.push_back(q);
+template <const auto& R>
+struct RuleTag
+{
+    static constexpr const auto& rule = R;
+};
+
+// Calls fn(RuleTag<...>{}) with the compile-time rule behind `rule`, so every rule runs its
+// own specialized kernel: withRule(r, [&](auto tag) { return applyRuleOnce<decltype(tag)::rule>(pts); }).
+template <class F>
+inline decltype(auto) withRule(CurveRule rule, F&& fn)
+{
+    switch (rule)
+    {
+    case CurveRule::Snowflake: return fn(RuleTag<kSnowflakeRule>{});
+    case CurveRule::Cesaro: return fn(RuleTag<kCesaroRule>{});
+    case CurveRule::LevyC: return fn(RuleTag<kLevyCRule>{});
+    case CurveRule::Peano: return fn(RuleTag<kPeanoRule>{});
+    case CurveRule::Dragon: return fn(RuleTag<kDragonRule>{});
+    default: return fn(RuleTag<kKoch2Rule>{});
     }
+}
 
-    return out;
+// Runtime facts about a rule for budgets and LOD.
+struct RuleInfo
+{
+    const char* name;
+    size_t children; // Segments per substituted segment.
+    float shrink; // Longest child over parent length.
+    int maxIters; // Deepest useful setting under the per-curve cap.
+};
+
+inline const RuleInfo& ruleInfo(CurveRule rule)
+{
+    static const auto infos = []
+        {
+            std::vector<RuleInfo> out;
+            for (int r = 0; r < kCurveRuleCount; ++r)
+            {
+                out.push_back(withRule(CurveRule(r), [](auto tag)
+                    {
+                        const auto& R = decltype(tag)::rule;
+                        constexpr size_t N = std::size(R.u);
+
+                        RuleInfo info{ R.name, N - 1, 0.f, 0 };
+                        for (size_t k = 0; k + 1 < N; ++k)
+                        {
+                            const float du = R.u[k + 1] - R.u[k], dv = R.v[k + 1] - R.v[k];
+                            info.shrink = std::max(info.shrink, std::sqrt(du * du + dv * dv) / R.scale);
+                        }
+
+                        // Same cut-off as the type-2 Koch slider: one level past the cap.
+                        for (size_t segs = 1; segs < 200000; segs *= info.children) ++info.maxIters;
+                        return info;
+                    }));
+            }
+            return out;
+        }();
+
+    const int i = int(rule);
+    return infos[i >= 0 && i < kCurveRuleCount ? i : 0];
+}
+
+// Quadratic type-2 Koch.
+inline std::vector<glm::vec2> applyKoch2Once(const std::vector<glm::vec2>& in)
+{
+    return applyRuleOnce<kKoch2Rule>(in);
 }
 
 // Heighway dragon.
@@ -85,6 +216,816 @@ inline std::vector<glm::vec2> applyDragonOnce(const std::vector<glm::vec2>& in)
     return out;
 }
 
+// Point cap of a single curve (the default maxSegments of the generators).
+inline constexpr size_t kMaxCurvePoints = 200000;
+
+// Deepest dragon setting. Past the cap, lines show a clamped template on screen; PNG export
+// streams them at full depth.
+inline constexpr int kMaxDragonIters = 30;
+
+// Depths a segment actually reaches under the segment budget (mirrors iterateTransform's early-outs).
+struct TransformDepths
+{
+    int koch2{ 0 };
+    int dragon{ 0 };
+    size_t points{ 2 };
+};
+
+// `rule` is the first stage (koch2Iters counts its steps); the dragon folds follow it.
+inline TransformDepths clampTransformDepths(
+    CurveRule rule,
+    const glm::vec2& a,
+    const glm::vec2& b,
+    int koch2Iters,
+    int dragonIters,
+    size_t maxSegments = 200000)
+{
+    // A zero-length base never grows under a rule (applyRuleOnce keeps it as one segment).
+    const size_t growth = glm::length(b - a) <= 0.0f ? 1 : ruleInfo(rule).children;
+
+    TransformDepths out;
+    size_t segs = 1;
+
+    for (int k = 0; k < koch2Iters; ++k)
+    {
+        segs *= growth;
+        ++out.koch2;
+        if (segs + 1 > maxSegments) break;
+    }
+
+    for (int d = 0; d < dragonIters; ++d)
+    {
+        segs *= 2;
+        ++out.dragon;
+        if (segs + 1 > maxSegments) break;
+    }
+
+    out.points = segs + 1;
+
+    return out;
+}
+
+inline TransformDepths clampTransformDepths(
+    const glm::vec2& a,
+    const glm::vec2& b,
+    int koch2Iters,
+    int dragonIters,
+    size_t maxSegments = 200000)
+{
+    return clampTransformDepths(CurveRule::Koch2, a, b, koch2Iters, dragonIters, maxSegments);
+}
+
+// Predictive clamp: the deepest level prefix with at most maxPoints points, worked out from the
+// growth factors before anything is expanded. Unlike clampTransformDepths it never overshoots
+// (that let a single Dragon 18, 262145 points, past the 200000 cap), so a deeper line shows
+// its capped template unless the view clips it (DeepZoomCache). Koch levels run first, so
+// cutting a Koch level also drops every dragon fold: the result is then a strided subset of
+// the target curve, which progressive refinement and prefix extension (EffectCache) build on.
+inline TransformDepths predictTransformDepths(
+    CurveRule rule,
+    const glm::vec2& a,
+    const glm::vec2& b,
+    int koch2Iters,
+    int dragonIters,
+    size_t maxPoints = kMaxCurvePoints)
+{
+    // A zero-length base never grows under a rule.
+    const size_t kochGrowth = glm::length(b - a) <= 0.0f ? 1 : ruleInfo(rule).children;
+
+    TransformDepths out;
+    size_t segs = 1;
+
+    for (int k = 0; k < koch2Iters; ++k)
+    {
+        if (segs * kochGrowth + 1 > maxPoints)
+        {
+            out.points = segs + 1;
+            return out;
+        }
+
+        segs *= kochGrowth;
+        ++out.koch2;
+    }
+
+    for (int d = 0; d < dragonIters && segs * 2 + 1 <= maxPoints; ++d)
+    {
+        segs *= 2;
+        ++out.dragon;
+    }
+
+    out.points = segs + 1;
+
+    return out;
+}
+
+inline TransformDepths predictTransformDepths(
+    const glm::vec2& a,
+    const glm::vec2& b,
+    int koch2Iters,
+    int dragonIters,
+    size_t maxPoints = kMaxCurvePoints)
+{
+    return predictTransformDepths(CurveRule::Koch2, a, b, koch2Iters, dragonIters, maxPoints);
+}
+
+// The 9 stencil points of one Koch step over (p, q), computed exactly as applyKoch2Once does.
+inline void koch2Anchors(const glm::vec2& p, const glm::vec2& q, glm::vec2 anchors[9])
+{
+    ruleAnchors<kKoch2Rule>(p, q, false, anchors);
+}
+
+// Maps a point of the unit segment (0,0)->(1,0) onto (a, b) by the similarity that takes one
+// segment to the other.
+inline glm::vec2 placeOnSegment(const glm::vec2& p, const glm::vec2& a, const glm::vec2& b)
+{
+    const glm::vec2 d = b - a;
+    return a + p.x * d + p.y * rot90L(d);
+}
+
+// Pixels per world unit along the longer axis of a view-projection's 2D part.
+inline float viewPixelScale(const glm::mat4& vp, int viewportW, int viewportH)
+{
+    const glm::vec2 ex(vp[0][0] * viewportW * 0.5f, vp[0][1] * viewportH * 0.5f);
+    const glm::vec2 ey(vp[1][0] * viewportW * 0.5f, vp[1][1] * viewportH * 0.5f);
+    return std::max(glm::length(ex), glm::length(ey));
+}
+
+// Screen-space LOD: keep subdividing only while segments project to at least tolPx pixels.
+// Every segment of a level has the same length (1/4 per Koch step, 1/sqrt2 per dragon fold),
+// so this reduces to per-line iteration counts. segmentPx is the base segment's length on screen;
+// kochShrink is the first stage's child-to-parent length (ruleInfo().shrink for other rules).
+inline void lodClampIters(float segmentPx, float tolPx, int& koch2Iters, int& dragonIters, float kochShrink = 0.25f)
+{
+    int k = 0;
+    while (k < koch2Iters && segmentPx >= tolPx)
+    {
+        segmentPx *= kochShrink;
+        ++k;
+    }
+
+    int d = 0;
+    while (d < dragonIters && segmentPx >= tolPx)
+    {
+        segmentPx *= 0.70710678f;
+        ++d;
+    }
+
+    koch2Iters = k;
+    dragonIters = d;
+}
+
+// Depth-first dragon fold below one segment; emits every point after a.
+template <class Sink>
+inline void streamDragonSegment(const glm::vec2& a, const glm::vec2& b, int depth, bool left, Sink& sink)
+{
+    if (depth <= 0)
+    {
+        sink(b);
+        return;
+    }
+
+    const glm::vec2 m = 0.5f * (a + b);
+    const glm::vec2 d = 0.5f * (b - a);
+    const glm::vec2 k = left ? (m + rot90L(d)) : (m + rot90R(d));
+
+    // Children of any segment sit at even/odd positions in the next level.
+    streamDragonSegment(a, k, depth - 1, false, sink);
+    streamDragonSegment(k, b, depth - 1, true, sink);
+}
+
+// Parity of child k of a segment whose index has parity `odd`, for rules with `children`
+// segments per step (child index = parent index * children + k).
+inline bool childOdd(bool odd, size_t children, size_t k)
+{
+    return (((odd ? children : 0) + k) & 1) != 0;
+}
+
+// ----------Analytic statistics----------
+// Segment count, length and bounds of a chain without expanding it. Bounds use the support
+// function h(t) = max over curve points p of p . (cos t, sin t), sampled every 15 degrees: that
+// set is closed under the 45, 60 and 90 degree turns of every rule but Cesaro, so each level is
+// a max over children of (child start . dir + child scale * child h at the rotated direction).
+// Cesaro's 85 degree children fall between samples and fall back to the enclosing polygon of the
+// level below, which keeps the bounds conservative.
+inline constexpr int kStatDirections = 24;
+
+struct CurveStats
+{
+    size_t segments{ 1 }; // Saturates at SIZE_MAX.
+    double length{ 1.0 }; // Relative to the base segment's length.
+
+    // Support of the curve over the unit segment (0,0)->(1,0) at 15 * j degrees. The curve lies
+    // inside the polygon these half-planes cut out.
+    double support[kStatDirections]{};
+    bool exact{ true }; // Support is the curve's own, not an upper bound.
+
+    // Axis-aligned box in the unit frame.
+    glm::dvec2 boundsMin{ 0.0 }, boundsMax{ 0.0 };
+};
+
+using StatSupport = std::array<double, kStatDirections>;
+
+inline glm::dvec2 statDirection(int j)
+{
+    static const auto table = []
+        {
+            std::array<glm::dvec2, kStatDirections> t;
+            for (int i = 0; i < kStatDirections; ++i)
+            {
+                const double a = i * (2.0 * 3.14159265358979323846 / kStatDirections);
+                t[size_t(i)] = { std::cos(a), std::sin(a) };
+            }
+            return t;
+        }();
+    return table[size_t(j)];
+}
+
+// Corners of the polygon cut out by h: corner j joins the edges at directions j and j + 1.
+inline void statCorners(const StatSupport& h, glm::dvec2* out)
+{
+    const double sinStep = std::sin(2.0 * 3.14159265358979323846 / kStatDirections);
+    for (int j = 0; j < kStatDirections; ++j)
+    {
+        const glm::dvec2 n0 = statDirection(j), n1 = statDirection((j + 1) % kStatDirections);
+        out[j] = glm::dvec2(h[j] * n1.y - h[(j + 1) % kStatDirections] * n0.y, h[(j + 1) % kStatDirections] * n0.x - h[j] * n1.x) / sinStep;
+    }
+}
+
+// Support of one child segment p -> q holding the curve `h` (given over the unit segment).
+// Returns false when the child's turn is not a whole number of samples (out is then a bound).
+inline bool statChildSupport(const glm::dvec2& p, const glm::dvec2& q, const StatSupport& h, StatSupport& out)
+{
+    const glm::dvec2 d = q - p;
+    const double s = glm::length(d);
+    const double turns = std::atan2(d.y, d.x) / (2.0 * 3.14159265358979323846 / kStatDirections);
+    const double whole = std::round(turns);
+
+    if (std::abs(turns - whole) < 1e-6)
+    {
+        const int r = int(whole);
+        for (int j = 0; j < kStatDirections; ++j)
+        {
+            out[j] = glm::dot(p, statDirection(j)) + s * h[((j - r) % kStatDirections + kStatDirections) % kStatDirections];
+        }
+        return true;
+    }
+
+    glm::dvec2 c[kStatDirections];
+    statCorners(h, c);
+    const glm::dvec2 f = d / s, n{ -f.y, f.x };
+    for (int j = 0; j < kStatDirections; ++j)
+    {
+        const glm::dvec2 u = statDirection(j);
+        double best = -1e300;
+        for (auto& v : c) best = std::max(best, glm::dot(v.x * f + v.y * n, u));
+        out[j] = glm::dot(p, u) + s * best;
+    }
+    return false;
+}
+
+// Statistics of koch2Iters steps of `rule` then dragonIters folds, relative to the base
+// segment; O(depth) work. Parity variants follow the expansion: dragon folds and alternating
+// rules turn even and odd segments differently.
+inline CurveStats curveStats(CurveRule rule, int koch2Iters, int dragonIters)
+{
+    CurveStats st;
+    auto grow = [](size_t x, size_t f) { return x > SIZE_MAX / f ? SIZE_MAX : x * f; };
+
+    // h[parity]: the curve below one segment of that parity, dragon levels first (they sit at
+    // the bottom of the tree).
+    StatSupport h[2];
+    for (int j = 0; j < kStatDirections; ++j) h[0][j] = h[1][j] = std::max(0.0, statDirection(j).x);
+
+    for (int d = 0; d < dragonIters; ++d)
+    {
+        StatSupport next[2];
+        for (int odd = 0; odd < 2; ++odd)
+        {
+            const glm::dvec2 k = odd ? glm::dvec2(0.5, 0.5) : glm::dvec2(0.5, -0.5);
+            StatSupport c0, c1;
+            st.exact &= statChildSupport({ 0.0, 0.0 }, k, h[0], c0);
+            st.exact &= statChildSupport(k, { 1.0, 0.0 }, h[1], c1);
+            for (int j = 0; j < kStatDirections; ++j) next[odd][j] = std::max(c0[j], c1[j]);
+        }
+        h[0] = next[0];
+        h[1] = next[1];
+
+        st.segments = grow(st.segments, 2);
+        st.length *= std::sqrt(2.0);
+    }
+
+    withRule(rule, [&](auto tag)
+        {
+            const auto& R = decltype(tag)::rule;
+            constexpr size_t N = std::size(R.u);
+
+            double childLength = 0.0;
+            for (size_t k = 0; k + 1 < N; ++k)
+            {
+                childLength += glm::length(glm::dvec2(R.u[k + 1] - R.u[k], R.v[k + 1] - R.v[k])) / R.scale;
+            }
+
+            for (int i = 0; i < koch2Iters; ++i)
+            {
+                StatSupport next[2];
+                for (int odd = 0; odd < 2; ++odd)
+                {
+                    const double mirror = R.alternate && !odd ? -1.0 : 1.0;
+                    next[odd].fill(-1e300);
+
+                    for (size_t k = 0; k + 1 < N; ++k)
+                    {
+                        const glm::dvec2 p(R.u[k] / R.scale, mirror * R.v[k] / R.scale);
+                        const glm::dvec2 q(R.u[k + 1] / R.scale, mirror * R.v[k + 1] / R.scale);
+                        StatSupport c;
+                        st.exact &= statChildSupport(p, q, h[childOdd(odd != 0, N - 1, k) ? 1 : 0], c);
+                        for (int j = 0; j < kStatDirections; ++j) next[odd][j] = std::max(next[odd][j], c[j]);
+                    }
+                }
+                h[0] = next[0];
+                h[1] = next[1];
+
+                st.segments = grow(st.segments, N - 1);
+                st.length *= childLength;
+            }
+        });
+
+    // The base segment is segment 0 of its level.
+    std::copy(h[0].begin(), h[0].end(), st.support);
+    st.boundsMax = { h[0][0], h[0][kStatDirections / 4] };
+    st.boundsMin = { -h[0][kStatDirections / 2], -h[0][3 * kStatDirections / 4] };
+
+    return st;
+}
+
+// World-space box of the curve on (a, b): the support polygon's corners placed on the segment.
+inline void curveWorldBounds(const CurveStats& st, const glm::vec2& a, const glm::vec2& b, glm::vec2& lo, glm::vec2& hi)
+{
+    StatSupport h;
+    std::copy(std::begin(st.support), std::end(st.support), h.begin());
+
+    glm::dvec2 c[kStatDirections];
+    statCorners(h, c);
+
+    lo = hi = a;
+    for (auto& v : c)
+    {
+        const glm::vec2 p = placeOnSegment(glm::vec2(v), a, b);
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+}
+
+// Depth-first rule expansion; leaves hand off to the dragon fold. `odd` is the parity of the
+// segment's index within its level (alternating rules mirror even segments). `leaf` counts final
+// rule segments so the first dragon level sees the same left/right alternation as applyDragonOnce.
+template <const auto& R, class Sink>
+inline void streamRuleSegment(const glm::vec2& p, const glm::vec2& q, int ruleDepth, bool odd, int dragonDepth, size_t& leaf, Sink& sink)
+{
+    constexpr size_t N = std::size(R.u);
+
+    if (ruleDepth <= 0 || glm::length(q - p) <= 0.0f)
+    {
+        streamDragonSegment(p, q, dragonDepth, (leaf++ & 1) != 0, sink);
+        return;
+    }
+
+    glm::vec2 anchors[N];
+    ruleAnchors<R>(p, q, R.alternate && !odd, anchors);
+
+    for (size_t k = 0; k + 1 < N; ++k)
+    {
+        streamRuleSegment<R>(anchors[k], anchors[k + 1], ruleDepth - 1, childOdd(odd, N - 1, k), dragonDepth, leaf, sink);
+    }
+}
+
+// Streaming generator: walks the substitution tree depth-first and hands final-level points
+// to sink(const glm::vec2&) in order. Same points as iterateTransform(rule, { a, b }, ...), but
+// working memory is O(depth) instead of a full vector per level.
+template <class Sink>
+inline void streamTransform(
+    CurveRule rule,
+    const glm::vec2& a,
+    const glm::vec2& b,
+    int koch2Iters,
+    int dragonIters,
+    Sink&& sink,
+    size_t maxSegments = 200000)
+{
+    const TransformDepths depths = clampTransformDepths(rule, a, b, koch2Iters, dragonIters, maxSegments);
+
+    size_t leaf = 0;
+    sink(a);
+    withRule(rule, [&](auto tag)
+        {
+            streamRuleSegment<decltype(tag)::rule>(a, b, depths.koch2, false, depths.dragon, leaf, sink);
+        });
+}
+
+template <class Sink>
+inline void streamTransform(
+    const glm::vec2& a,
+    const glm::vec2& b,
+    int koch2Iters,
+    int dragonIters,
+    Sink&& sink,
+    size_t maxSegments = 200000)
+{
+    streamTransform(CurveRule::Koch2, a, b, koch2Iters, dragonIters, sink, maxSegments);
+}
+
+// Every point below a segment of length L, at any depth of a registered rule followed by
+// dragon folds, stays within kSubtreeReach * L of the segment's midpoint. A step whose children
+// (shrink s) sit at most m * L from the parent midpoint needs r >= m + s * r: the dragon fold
+// and Levy C (s = 1/sqrt2, m = sqrt2/4) need 1.21, the other rules about 0.5.
+inline constexpr float kSubtreeReach = 1.25f;
+
+// Traversal state for streamTransformCulled.
+struct CullState
+{
+    glm::vec2 lo, hi; // View rectangle, grown by the margin.
+    size_t budget; // Points still allowed.
+    bool broken; // A subtree was skipped since the last emitted point.
+};
+
+// Whether the subtree below (a, b) may reach the view rectangle.
+inline bool subtreeVisible(const glm::vec2& a, const glm::vec2& b, const CullState& st)
+{
+    const glm::vec2 m = 0.5f * (a + b);
+    const float r = kSubtreeReach * glm::length(b - a);
+
+    return m.x + r >= st.lo.x && m.x - r <= st.hi.x && m.y + r >= st.lo.y && m.y - r <= st.hi.y;
+}
+
+// Culled dragon fold. Returns false once the budget is spent.
+template <class Sink>
+inline bool streamDragonCulled(const glm::vec2& a, const glm::vec2& b, int depth, bool left, CullState& st, Sink& sink)
+{
+    if (!subtreeVisible(a, b, st))
+    {
+        st.broken = true;
+        return true;
+    }
+
+    if (depth <= 0)
+    {
+        // Reopen the polyline at this segment's start after a gap.
+        const size_t need = st.broken ? 2 : 1;
+        if (st.budget < need) return false;
+        st.budget -= need;
+
+        if (st.broken) sink(a, true);
+        sink(b, false);
+        st.broken = false;
+        return true;
+    }
+
+    const glm::vec2 m = 0.5f * (a + b);
+    const glm::vec2 d = 0.5f * (b - a);
+    const glm::vec2 k = left ? (m + rot90L(d)) : (m + rot90R(d));
+
+    return streamDragonCulled(a, k, depth - 1, false, st, sink)
+        && streamDragonCulled(k, b, depth - 1, true, st, sink);
+}
+
+// Culled rule expansion. A skipped subtree still advances `leaf` by its leaf count so the
+// dragon alternation of visible leaves matches the full curve.
+template <const auto& R, class Sink>
+inline bool streamRuleCulled(const glm::vec2& p, const glm::vec2& q, int ruleDepth, bool odd, int dragonDepth, size_t& leaf, CullState& st, Sink& sink)
+{
+    constexpr size_t N = std::size(R.u);
+
+    if (ruleDepth <= 0 || glm::length(q - p) <= 0.0f)
+    {
+        return streamDragonCulled(p, q, dragonDepth, (leaf++ & 1) != 0, st, sink);
+    }
+
+    if (!subtreeVisible(p, q, st))
+    {
+        size_t leaves = 1;
+        for (int k = 0; k < ruleDepth; ++k) leaves *= N - 1;
+
+        leaf += leaves;
+        st.broken = true;
+        return true;
+    }
+
+    glm::vec2 anchors[N];
+    ruleAnchors<R>(p, q, R.alternate && !odd, anchors);
+
+    for (size_t k = 0; k + 1 < N; ++k)
+    {
+        if (!streamRuleCulled<R>(anchors[k], anchors[k + 1], ruleDepth - 1, childOdd(odd, N - 1, k), dragonDepth, leaf, st, sink)) return false;
+    }
+
+    return true;
+}
+
+// View-culled generator for deep zoom: subtrees whose reach misses [viewMin, viewMax] (grown by
+// margin) are skipped, so the full requested depth is expanded only where it is visible.
+// maxPoints caps what is emitted instead of the whole-curve budget. Points go to
+// sink(const glm::vec2& p, bool startsRun); a new run begins after every gap. Returns false
+// when maxPoints ran out first: the output then stops partway along the curve.
+template <class Sink>
+inline bool streamTransformCulled(
+    CurveRule rule,
+    const glm::vec2& a,
+    const glm::vec2& b,
+    int koch2Iters,
+    int dragonIters,
+    const glm::vec2& viewMin,
+    const glm::vec2& viewMax,
+    float margin,
+    Sink&& sink,
+    size_t maxPoints = 200000)
+{
+    CullState st{ viewMin - glm::vec2(margin), viewMax + glm::vec2(margin), maxPoints, true };
+
+    size_t leaf = 0;
+    return withRule(rule, [&](auto tag)
+        {
+            return streamRuleCulled<decltype(tag)::rule>(a, b, std::max(0, koch2Iters), false, std::max(0, dragonIters), leaf, st, sink);
+        });
+}
+
+// Closed-form Koch: vertex i (0..8^depth) of the depth-level curve over (a, b). Each base-8
+// digit of i, most significant first, picks one stencil child, so this costs O(depth) and
+// matches iterateTransform's points bit for bit.
+inline glm::vec2 koch2VertexAt(const glm::vec2& a, const glm::vec2& b, int depth, size_t i)
+{
+    if (i == 0) return a;
+
+    // A zero-length base stays a single segment at every depth.
+    if (depth <= 0 || glm::length(b - a) <= 0.0f) return b;
+
+    const size_t total = size_t(1) << (3 * depth);
+    if (i >= total) return b;
+
+    glm::vec2 p = a, q = b;
+    for (int level = depth - 1; level >= 0; --level)
+    {
+        const size_t digit = (i >> (3 * level)) & 7;
+
+        glm::vec2 anchors[9];
+        koch2Anchors(p, q, anchors);
+        p = anchors[digit];
+        q = anchors[digit + 1];
+    }
+
+    return p;
+}
+
+// Subtree walk for koch2VertexRange: emits starts of leaves in [first, last).
+inline void koch2RangeSegment(const glm::vec2& p, const glm::vec2& q, int level, size_t index, size_t first, size_t last, glm::vec2* out)
+{
+    if (level == 0)
+    {
+        out[index - first] = p;
+        return;
+    }
+
+    const size_t span = size_t(1) << (3 * (level - 1));
+
+    glm::vec2 anchors[9];
+    koch2Anchors(p, q, anchors);
+
+    for (int k = 0; k < 8; ++k)
+    {
+        const size_t childFirst = index + k * span;
+        if (childFirst >= last) break;
+        if (childFirst + span <= first) continue;
+        koch2RangeSegment(anchors[k], anchors[k + 1], level - 1, childFirst, first, last, out);
+    }
+}
+
+// Closed-form Koch over an index range: writes vertices [first, first + count) to out.
+// Subtrees outside the range are skipped, so cost is O(depth + count).
+inline void koch2VertexRange(const glm::vec2& a, const glm::vec2& b, int depth, size_t first, size_t count, glm::vec2* out)
+{
+    if (count == 0) return;
+
+    const bool degenerate = depth <= 0 || glm::length(b - a) <= 0.0f;
+    const size_t total = degenerate ? 1 : size_t(1) << (3 * depth);
+    const size_t last = std::min(first + count, total + 1);
+
+    if (first < total)
+    {
+        if (degenerate) out[0] = a;
+        else koch2RangeSegment(a, b, depth, 0, first, std::min(last, total), out);
+    }
+
+    if (last == total + 1) out[total - first] = b;
+}
+
+// Closed-form Heighway dragon. After `depth` folds every segment is the base rotated by
+// -45 * depth degrees, shrunk by sqrt(2)^depth, then turned by a multiple of 90 degrees:
+// the number of set bits in the Gray code of its index (with the base segment's parity on
+// top). Equivalently, the turn at vertex i is set by the bit above i's lowest set bit.
+// Positions are integer prefix sums on that lattice, so blocks of segments are independent.
+inline int dragonQuarterTurns(size_t segment, int depth, bool left)
+{
+    const size_t j = segment | (size_t(left ? 1 : 0) << depth);
+    const size_t mask = (size_t(1) << depth) - 1;
+    return std::popcount((j ^ (j >> 1)) & mask) & 3;
+}
+
+// Lattice frame of a folded segment: vertex = origin + e1 * x + rot90L(e1) * y.
+struct DragonFrame
+{
+    double ox{ 0 }, oy{ 0 };
+    double e1x{ 0 }, e1y{ 0 };
+};
+
+inline DragonFrame dragonFrame(const glm::vec2& a, const glm::vec2& b, int depth)
+{
+    // ((1 - i) / 2)^depth is the per-fold rotate-and-shrink; exact in double (dyadic).
+    double cr = 1.0, ci = 0.0;
+    for (int k = 0; k < depth; ++k)
+    {
+        const double r = 0.5 * (cr + ci);
+        const double i = 0.5 * (ci - cr);
+        cr = r; ci = i;
+    }
+
+    const double dx = double(b.x) - double(a.x);
+    const double dy = double(b.y) - double(a.y);
+
+    DragonFrame f;
+    f.ox = a.x; f.oy = a.y;
+    f.e1x = dx * cr - dy * ci;
+    f.e1y = dx * ci + dy * cr;
+    return f;
+}
+
+// Unit lattice step for a quarter-turn count (0..3).
+inline void dragonStep(int turns, int64_t& x, int64_t& y)
+{
+    static const int SX[4] = { 1, 0, -1, 0 };
+    static const int SY[4] = { 0, 1, 0, -1 };
+    x += SX[turns];
+    y += SY[turns];
+}
+
+// Writes vertices first+1..last of a folded segment, starting from lattice point (x, y).
+inline void dragonFillRange(const DragonFrame& f, int depth, bool left, size_t first, size_t last, int64_t x, int64_t y, glm::vec2* out)
+{
+    for (size_t t = first; t < last; ++t)
+    {
+        dragonStep(dragonQuarterTurns(t, depth, left), x, y);
+        out[t] = glm::vec2(
+            float(f.ox + f.e1x * double(x) - f.e1y * double(y)),
+            float(f.oy + f.e1y * double(x) + f.e1x * double(y)));
+    }
+}
+
+// Closed-form fold of one segment: writes the 2^depth points after a (the last is b).
+inline void dragonSegmentClosedForm(const glm::vec2& a, const glm::vec2& b, int depth, bool left, glm::vec2* out)
+{
+    const size_t count = size_t(1) << depth;
+    dragonFillRange(dragonFrame(a, b, depth), depth, left, 0, count - 1, 0, 0, out);
+    out[count - 1] = b;
+}
+
+// Same as dragonSegmentClosedForm, split into blocks across the pool: each block sums its
+// lattice steps, an exclusive prefix sum stitches the block origins, then blocks write.
+inline void dragonSegmentParallel(const glm::vec2& a, const glm::vec2& b, int depth, bool left, glm::vec2* out, ThreadPool& pool, const std::atomic<bool>* cancel = nullptr)
+{
+    const size_t count = size_t(1) << depth;
+    const size_t block = 4096;
+    const size_t blocks = (count + block - 1) / block;
+
+    if (blocks < 2 || pool.concurrency() < 2)
+    {
+        dragonSegmentClosedForm(a, b, depth, left, out);
+        return;
+    }
+
+    const DragonFrame f = dragonFrame(a, b, depth);
+    std::vector<int64_t> bx(blocks + 1, 0), by(blocks + 1, 0);
+
+    pool.parallelFor(blocks, 1, [&](size_t begin, size_t end)
+        {
+            if (cancel && cancel->load(std::memory_order_relaxed)) return;
+
+            for (size_t k = begin; k < end; ++k)
+            {
+                int64_t x = 0, y = 0;
+                const size_t last = std::min(count, (k + 1) * block);
+                for (size_t t = k * block; t < last; ++t) dragonStep(dragonQuarterTurns(t, depth, left), x, y);
+                bx[k + 1] = x; by[k + 1] = y;
+            }
+        });
+
+    for (size_t k = 0; k < blocks; ++k)
+    {
+        bx[k + 1] += bx[k];
+        by[k + 1] += by[k];
+    }
+
+    pool.parallelFor(blocks, 1, [&](size_t begin, size_t end)
+        {
+            if (cancel && cancel->load(std::memory_order_relaxed)) return;
+
+            for (size_t k = begin; k < end; ++k)
+            {
+                const size_t last = std::min(count - 1, (k + 1) * block);
+                dragonFillRange(f, depth, left, k * block, last, bx[k], by[k], out);
+            }
+        });
+
+    out[count - 1] = b;
+}
+
+// Parallel generator: splits the final Koch segments into chunks across the shared pool.
+// Every chunk locates its first vertex from the base-8 digits and folds its dragon in closed
+// form, so no level depends on another. When there are too few Koch segments to go round,
+// each one's dragon is split into blocks instead. Koch-only output matches streamTransform
+// exactly; dragon points agree to float rounding (the lattice sums are exact).
+// A set `cancel` flag makes remaining chunks return early; the output is then unusable.
+inline void generateTransformParallel(
+    const glm::vec2& a,
+    const glm::vec2& b,
+    int koch2Iters,
+    int dragonIters,
+    std::vector<glm::vec2>& out,
+    size_t maxSegments = 200000,
+    const std::atomic<bool>* cancel = nullptr)
+{
+    const TransformDepths depths = clampTransformDepths(a, b, koch2Iters, dragonIters, maxSegments);
+    const size_t perLeaf = size_t(1) << depths.dragon;
+    const size_t leaves = (depths.points - 1) / perLeaf;
+
+    ThreadPool& pool = sharedThreadPool();
+
+    out.resize(depths.points);
+    out[0] = a;
+
+    if (leaves < pool.concurrency() * 4)
+    {
+        std::vector<glm::vec2> ends(leaves + 1);
+        koch2VertexRange(a, b, depths.koch2, 0, ends.size(), ends.data());
+
+        for (size_t j = 0; j < leaves; ++j)
+        {
+            if (cancel && cancel->load(std::memory_order_relaxed)) return;
+            dragonSegmentParallel(ends[j], ends[j + 1], depths.dragon, (j & 1) != 0, out.data() + 1 + j * perLeaf, pool, cancel);
+        }
+        return;
+    }
+
+    // Aim for chunks of a few thousand output points.
+    const size_t grain = std::max<size_t>(1, 4096 / perLeaf);
+
+    pool.parallelFor(leaves, grain, [&](size_t begin, size_t end)
+        {
+            if (cancel && cancel->load(std::memory_order_relaxed)) return;
+
+            std::vector<glm::vec2> ends(end - begin + 1);
+            koch2VertexRange(a, b, depths.koch2, begin, ends.size(), ends.data());
+
+            for (size_t j = begin; j < end; ++j)
+            {
+                dragonSegmentClosedForm(ends[j - begin], ends[j - begin + 1], depths.dragon, (j & 1) != 0, out.data() + 1 + j * perLeaf);
+            }
+        });
+}
+
+// First stage only: `iters` steps of `rule`, stopping once the polyline passes maxSegments.
+inline std::vector<glm::vec2> iterateRule(CurveRule rule, const std::vector<glm::vec2>& base, int iters, size_t maxSegments = 200000)
+{
+    return withRule(rule, [&](auto tag)
+        {
+            std::vector<glm::vec2> cur = base;
+
+            for (int k = 0; k < iters; ++k)
+            {
+                cur = applyRuleOnce<decltype(tag)::rule>(cur);
+                if (cur.size() > maxSegments) break;
+            }
+
+            return cur;
+        });
+}
+
+// Iterate with a segment budget: `rule` steps, then dragon folds.
+inline std::vector<glm::vec2> iterateTransform(
+    CurveRule rule,
+    const std::vector<glm::vec2>& base,
+    int koch2Iters,
+    int dragonIters,
+    size_t maxSegments = 200000)
+{
+    std::vector<glm::vec2> cur = iterateRule(rule, base, koch2Iters, maxSegments);
+
+    for (int d = 0; d < dragonIters; ++d)
+    {
+        cur = applyDragonOnce(cur);
+        if (cur.size() > maxSegments) break;
+    }
+
+    return cur;
+}
+
 // Iterate with a segment budget.
 inline std::vector<glm::vec2> iterateTransform(
     const std::vector<glm::vec2>& base,
@@ -0,0 +1,629 @@
+#include "TransformsSimd.h"
+#include "Transforms.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define TRANSFORMS_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC/Clang need per-function ISA targets; MSVC accepts intrinsics anywhere.
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMD_TARGET(isa)
+#endif
+
+// CPU detection.
+static SimdLevel queryCpu()
+{
+#if defined(TRANSFORMS_SIMD_X86)
+#if defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    const bool sse2 = (info[3] & (1 << 26)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+
+    bool avx2 = false;
+    if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+
+    if (avx2) return SimdLevel::AVX2;
+    if (sse2) return SimdLevel::SSE2;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE2;
+#endif
+#endif
+    return SimdLevel::Scalar;
+}
+
+SimdLevel detectSimdLevel()
+{
+    static const SimdLevel level = queryCpu();
+    return level;
+}
+
+const char* simdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::AVX2: return "AVX2";
+    case SimdLevel::SSE2: return "SSE2";
+    default: return "Scalar";
+    }
+}
+
+// AoS <-> SoA.
+CurveSoA toSoA(const std::vector<glm::vec2>& pts)
+{
+    CurveSoA soa;
+    soa.resize(pts.size());
+
+    for (size_t i = 0; i < pts.size(); ++i)
+    {
+        soa.x[i] = pts[i].x;
+        soa.y[i] = pts[i].y;
+    }
+
+    return soa;
+}
+
+std::vector<glm::vec2> toAoS(const CurveSoA& soa)
+{
+    std::vector<glm::vec2> pts(soa.size());
+
+    for (size_t i = 0; i < pts.size(); ++i)
+    {
+        pts[i] = { soa.x[i], soa.y[i] };
+    }
+
+    return pts;
+}
+
+// ----------Scalar kernels (also used for SIMD tails)----------
+// Same expression order as applyKoch2Once so every lane rounds identically.
+static bool koch2Scalar(const float* x, const float* y, size_t first, size_t last, float* ox, float* oy)
+{
+    for (size_t i = first; i < last; ++i)
+    {
+        const float dx = x[i + 1] - x[i];
+        const float dy = y[i + 1] - y[i];
+        const float L = std::sqrt(dx * dx + dy * dy);
+        if (L <= 0.0f) return false;
+
+        const float fx = dx / L, fy = dy / L;
+        const float nx = -fy, ny = fx;
+        const float s = L * 0.25f;
+
+        float* px = ox + 8 * i + 1;
+        float* py = oy + 8 * i + 1;
+        for (int k = 1; k <= 7; ++k)
+        {
+            const float us = kKoch2Rule.u[k] * s;
+            const float vs = kKoch2Rule.v[k] * s;
+            px[k - 1] = x[i] + fx * us + nx * vs;
+            py[k - 1] = y[i] + fy * us + ny * vs;
+        }
+        px[7] = x[i + 1];
+        py[7] = y[i + 1];
+    }
+
+    return true;
+}
+
+static void dragonScalar(const float* x, const float* y, size_t first, size_t last, float* ox, float* oy)
+{
+    for (size_t i = first; i < last; ++i)
+    {
+        const float mx = 0.5f * (x[i] + x[i + 1]);
+        const float my = 0.5f * (y[i] + y[i + 1]);
+        const float dx = 0.5f * (x[i + 1] - x[i]);
+        const float dy = 0.5f * (y[i + 1] - y[i]);
+        const bool left = (i & 1) != 0;
+
+        ox[2 * i + 1] = left ? mx + -dy : mx + dy;
+        oy[2 * i + 1] = left ? my + dx : my + -dx;
+        ox[2 * i + 2] = x[i + 1];
+        oy[2 * i + 2] = y[i + 1];
+    }
+}
+
+// ----------Composite stencils----------
+// Points of several levels over the unit segment (0,0)->(1,0) in double, without the start point.
+// A segment (p, q) places point m at p + u[m] * (q - p) + v[m] * rot90L(q - p); the last point
+// is q itself. Dragon stencils come in two variants: children of even and of odd segments.
+struct CompositeStencil
+{
+    std::vector<float> u, v;
+};
+
+static void koch2Composite(glm::dvec2 p, glm::dvec2 q, int levels, CompositeStencil& out)
+{
+    if (levels == 0)
+    {
+        out.u.push_back(float(q.x));
+        out.v.push_back(float(q.y));
+        return;
+    }
+
+    const glm::dvec2 d = 0.25 * (q - p);
+    const glm::dvec2 n{ -d.y, d.x };
+    glm::dvec2 prev = p;
+    for (int k = 1; k < 9; ++k)
+    {
+        const glm::dvec2 a = k == 8 ? q : p + double(kKoch2Rule.u[k]) * d + double(kKoch2Rule.v[k]) * n;
+        koch2Composite(prev, a, levels - 1, out);
+        prev = a;
+    }
+}
+
+static void dragonComposite(glm::dvec2 p, glm::dvec2 q, int levels, bool left, CompositeStencil& out)
+{
+    if (levels == 0)
+    {
+        out.u.push_back(float(q.x));
+        out.v.push_back(float(q.y));
+        return;
+    }
+
+    const glm::dvec2 m = 0.5 * (p + q);
+    const glm::dvec2 d = 0.5 * (q - p);
+    const glm::dvec2 k = left ? m + glm::dvec2(-d.y, d.x) : m + glm::dvec2(d.y, -d.x);
+    dragonComposite(p, k, levels - 1, false, out);
+    dragonComposite(k, q, levels - 1, true, out);
+}
+
+// Built once; levels 2..kMaxFusedLevels.
+static const CompositeStencil& koch2Stencil(int levels)
+{
+    static const auto table = []
+        {
+            std::vector<CompositeStencil> t(kMaxFusedLevels + 1);
+            for (int l = 2; l <= kMaxFusedLevels; ++l) koch2Composite({ 0.0, 0.0 }, { 1.0, 0.0 }, l, t[size_t(l)]);
+            return t;
+        }();
+    return table[size_t(levels)];
+}
+
+static const CompositeStencil& dragonStencil(int levels, bool odd)
+{
+    static const auto table = []
+        {
+            std::vector<CompositeStencil> t(2 * (kMaxFusedLevels + 1));
+            for (int l = 2; l <= kMaxFusedLevels; ++l)
+            {
+                dragonComposite({ 0.0, 0.0 }, { 1.0, 0.0 }, l, false, t[size_t(2 * l)]);
+                dragonComposite({ 0.0, 0.0 }, { 1.0, 0.0 }, l, true, t[size_t(2 * l + 1)]);
+            }
+            return t;
+        }();
+    return table[size_t(2 * levels + (odd ? 1 : 0))];
+}
+
+// Segment i writes out[count*i+1 .. count*i+count] from stencil[i & 1]. With checkLength, a
+// zero-length segment stops the pass (as the Koch kernels do) and false is returned.
+static bool placeScalar(const float* x, const float* y, size_t first, size_t last, const CompositeStencil* const stencil[2], bool checkLength, float* ox, float* oy)
+{
+    const size_t count = stencil[0]->u.size();
+
+    for (size_t i = first; i < last; ++i)
+    {
+        const float dx = x[i + 1] - x[i];
+        const float dy = y[i + 1] - y[i];
+        if (checkLength && std::sqrt(dx * dx + dy * dy) <= 0.0f) return false;
+
+        const float* u = stencil[i & 1]->u.data();
+        const float* v = stencil[i & 1]->v.data();
+        float* px = ox + count * i + 1;
+        float* py = oy + count * i + 1;
+        for (size_t m = 0; m + 1 < count; ++m)
+        {
+            px[m] = x[i] + u[m] * dx - v[m] * dy;
+            py[m] = y[i] + u[m] * dy + v[m] * dx;
+        }
+        px[count - 1] = x[i + 1];
+        py[count - 1] = y[i + 1];
+    }
+
+    return true;
+}
+
+#if defined(TRANSFORMS_SIMD_X86)
+// ----------SSE2 kernels----------
+// Four segments per step for length/normal, then each segment's 8 stencil points as two
+// 4-wide rows written at their fixed offset.
+SIMD_TARGET("sse2")
+static bool koch2Sse2(const float* x, const float* y, size_t segs, float* ox, float* oy)
+{
+    const __m128 uLo = _mm_setr_ps(1, 1, 2, 2), uHi = _mm_setr_ps(2, 3, 3, 4);
+    const __m128 vLo = _mm_setr_ps(0, 1, 1, 0), vHi = _mm_setr_ps(-1, -1, 0, 0);
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    const __m128 zero = _mm_setzero_ps();
+
+    alignas(16) float fxs[4], fys[4], ss[4];
+
+    size_t i = 0;
+    for (; i + 4 <= segs; i += 4)
+    {
+        const __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i + 1), _mm_loadu_ps(x + i));
+        const __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i + 1), _mm_loadu_ps(y + i));
+        const __m128 L = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+        if (_mm_movemask_ps(_mm_cmple_ps(L, zero))) return false;
+
+        _mm_store_ps(fxs, _mm_div_ps(dx, L));
+        _mm_store_ps(fys, _mm_div_ps(dy, L));
+        _mm_store_ps(ss, _mm_mul_ps(L, quarter));
+
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            const size_t j = i + lane;
+            const __m128 px = _mm_set1_ps(x[j]), py = _mm_set1_ps(y[j]);
+            const __m128 fx = _mm_set1_ps(fxs[lane]), fy = _mm_set1_ps(fys[lane]);
+            const __m128 nx = _mm_set1_ps(-fys[lane]), ny = fx;
+            const __m128 s = _mm_set1_ps(ss[lane]);
+
+            const __m128 usLo = _mm_mul_ps(uLo, s), vsLo = _mm_mul_ps(vLo, s);
+            const __m128 usHi = _mm_mul_ps(uHi, s), vsHi = _mm_mul_ps(vHi, s);
+
+            float* dx8 = ox + 8 * j + 1;
+            float* dy8 = oy + 8 * j + 1;
+            _mm_storeu_ps(dx8, _mm_add_ps(_mm_add_ps(px, _mm_mul_ps(fx, usLo)), _mm_mul_ps(nx, vsLo)));
+            _mm_storeu_ps(dy8, _mm_add_ps(_mm_add_ps(py, _mm_mul_ps(fy, usLo)), _mm_mul_ps(ny, vsLo)));
+            _mm_storeu_ps(dx8 + 4, _mm_add_ps(_mm_add_ps(px, _mm_mul_ps(fx, usHi)), _mm_mul_ps(nx, vsHi)));
+            _mm_storeu_ps(dy8 + 4, _mm_add_ps(_mm_add_ps(py, _mm_mul_ps(fy, usHi)), _mm_mul_ps(ny, vsHi)));
+
+            // Snap the last anchor to q.
+            dx8[7] = x[j + 1];
+            dy8[7] = y[j + 1];
+        }
+    }
+
+    return koch2Scalar(x, y, i, segs, ox, oy);
+}
+
+// Four folds per step; fold points are interleaved with the segment ends on store.
+SIMD_TARGET("sse2")
+static void dragonSse2(const float* x, const float* y, size_t segs, float* ox, float* oy)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 signX = _mm_setr_ps(1, -1, 1, -1); // Even segments turn right, odd left.
+    const __m128 signY = _mm_setr_ps(-1, 1, -1, 1);
+
+    size_t i = 0;
+    for (; i + 4 <= segs; i += 4)
+    {
+        const __m128 ax = _mm_loadu_ps(x + i), bx = _mm_loadu_ps(x + i + 1);
+        const __m128 ay = _mm_loadu_ps(y + i), by = _mm_loadu_ps(y + i + 1);
+        const __m128 mx = _mm_mul_ps(half, _mm_add_ps(ax, bx));
+        const __m128 my = _mm_mul_ps(half, _mm_add_ps(ay, by));
+        const __m128 dx = _mm_mul_ps(half, _mm_sub_ps(bx, ax));
+        const __m128 dy = _mm_mul_ps(half, _mm_sub_ps(by, ay));
+        const __m128 kx = _mm_add_ps(mx, _mm_mul_ps(signX, dy));
+        const __m128 ky = _mm_add_ps(my, _mm_mul_ps(signY, dx));
+
+        _mm_storeu_ps(ox + 2 * i + 1, _mm_unpacklo_ps(kx, bx));
+        _mm_storeu_ps(ox + 2 * i + 5, _mm_unpackhi_ps(kx, bx));
+        _mm_storeu_ps(oy + 2 * i + 1, _mm_unpacklo_ps(ky, by));
+        _mm_storeu_ps(oy + 2 * i + 5, _mm_unpackhi_ps(ky, by));
+    }
+
+    dragonScalar(x, y, i, segs, ox, oy);
+}
+
+// Composite stencil points four at a time per segment; same expression order as placeScalar.
+SIMD_TARGET("sse2")
+static bool placeSse2(const float* x, const float* y, size_t segs, const CompositeStencil* const stencil[2], bool checkLength, float* ox, float* oy)
+{
+    const size_t count = stencil[0]->u.size();
+
+    for (size_t i = 0; i < segs; ++i)
+    {
+        const float dxs = x[i + 1] - x[i];
+        const float dys = y[i + 1] - y[i];
+        if (checkLength && std::sqrt(dxs * dxs + dys * dys) <= 0.0f) return false;
+
+        const __m128 px = _mm_set1_ps(x[i]), py = _mm_set1_ps(y[i]);
+        const __m128 dx = _mm_set1_ps(dxs), dy = _mm_set1_ps(dys);
+        const float* u = stencil[i & 1]->u.data();
+        const float* v = stencil[i & 1]->v.data();
+        float* ux = ox + count * i + 1;
+        float* uy = oy + count * i + 1;
+
+        size_t m = 0;
+        for (; m + 4 <= count; m += 4)
+        {
+            const __m128 su = _mm_loadu_ps(u + m), sv = _mm_loadu_ps(v + m);
+            _mm_storeu_ps(ux + m, _mm_sub_ps(_mm_add_ps(px, _mm_mul_ps(su, dx)), _mm_mul_ps(sv, dy)));
+            _mm_storeu_ps(uy + m, _mm_add_ps(_mm_add_ps(py, _mm_mul_ps(su, dy)), _mm_mul_ps(sv, dx)));
+        }
+        for (; m < count; ++m)
+        {
+            ux[m] = x[i] + u[m] * dxs - v[m] * dys;
+            uy[m] = y[i] + u[m] * dys + v[m] * dxs;
+        }
+
+        ux[count - 1] = x[i + 1];
+        uy[count - 1] = y[i + 1];
+    }
+
+    return true;
+}
+
+// ----------AVX2 kernels----------
+// Eight segments per step; each segment's 8 stencil points fill one 8-wide row.
+SIMD_TARGET("avx2")
+static bool koch2Avx2(const float* x, const float* y, size_t segs, float* ox, float* oy)
+{
+    const __m256 u = _mm256_setr_ps(1, 1, 2, 2, 2, 3, 3, 4);
+    const __m256 v = _mm256_setr_ps(0, 1, 1, 0, -1, -1, 0, 0);
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    const __m256 zero = _mm256_setzero_ps();
+
+    alignas(32) float fxs[8], fys[8], ss[8];
+
+    size_t i = 0;
+    for (; i + 8 <= segs; i += 8)
+    {
+        const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + i + 1), _mm256_loadu_ps(x + i));
+        const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + i + 1), _mm256_loadu_ps(y + i));
+        const __m256 L = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+        if (_mm256_movemask_ps(_mm256_cmp_ps(L, zero, _CMP_LE_OQ))) return false;
+
+        _mm256_store_ps(fxs, _mm256_div_ps(dx, L));
+        _mm256_store_ps(fys, _mm256_div_ps(dy, L));
+        _mm256_store_ps(ss, _mm256_mul_ps(L, quarter));
+
+        for (int lane = 0; lane < 8; ++lane)
+        {
+            const size_t j = i + lane;
+            const __m256 px = _mm256_set1_ps(x[j]), py = _mm256_set1_ps(y[j]);
+            const __m256 fx = _mm256_set1_ps(fxs[lane]), fy = _mm256_set1_ps(fys[lane]);
+            const __m256 nx = _mm256_set1_ps(-fys[lane]), ny = fx;
+            const __m256 s = _mm256_set1_ps(ss[lane]);
+            const __m256 us = _mm256_mul_ps(u, s), vs = _mm256_mul_ps(v, s);
+
+            float* dx8 = ox + 8 * j + 1;
+            float* dy8 = oy + 8 * j + 1;
+            _mm256_storeu_ps(dx8, _mm256_add_ps(_mm256_add_ps(px, _mm256_mul_ps(fx, us)), _mm256_mul_ps(nx, vs)));
+            _mm256_storeu_ps(dy8, _mm256_add_ps(_mm256_add_ps(py, _mm256_mul_ps(fy, us)), _mm256_mul_ps(ny, vs)));
+
+            dx8[7] = x[j + 1];
+            dy8[7] = y[j + 1];
+        }
+    }
+
+    return koch2Scalar(x, y, i, segs, ox, oy);
+}
+
+SIMD_TARGET("avx2")
+static void dragonAvx2(const float* x, const float* y, size_t segs, float* ox, float* oy)
+{
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 signX = _mm256_setr_ps(1, -1, 1, -1, 1, -1, 1, -1);
+    const __m256 signY = _mm256_setr_ps(-1, 1, -1, 1, -1, 1, -1, 1);
+
+    size_t i = 0;
+    for (; i + 8 <= segs; i += 8)
+    {
+        const __m256 ax = _mm256_loadu_ps(x + i), bx = _mm256_loadu_ps(x + i + 1);
+        const __m256 ay = _mm256_loadu_ps(y + i), by = _mm256_loadu_ps(y + i + 1);
+        const __m256 mx = _mm256_mul_ps(half, _mm256_add_ps(ax, bx));
+        const __m256 my = _mm256_mul_ps(half, _mm256_add_ps(ay, by));
+        const __m256 dx = _mm256_mul_ps(half, _mm256_sub_ps(bx, ax));
+        const __m256 dy = _mm256_mul_ps(half, _mm256_sub_ps(by, ay));
+        const __m256 kx = _mm256_add_ps(mx, _mm256_mul_ps(signX, dy));
+        const __m256 ky = _mm256_add_ps(my, _mm256_mul_ps(signY, dx));
+
+        // unpack works per 128-bit half; permute restores segment order.
+        const __m256 xLo = _mm256_unpacklo_ps(kx, bx), xHi = _mm256_unpackhi_ps(kx, bx);
+        const __m256 yLo = _mm256_unpacklo_ps(ky, by), yHi = _mm256_unpackhi_ps(ky, by);
+        _mm256_storeu_ps(ox + 2 * i + 1, _mm256_permute2f128_ps(xLo, xHi, 0x20));
+        _mm256_storeu_ps(ox + 2 * i + 9, _mm256_permute2f128_ps(xLo, xHi, 0x31));
+        _mm256_storeu_ps(oy + 2 * i + 1, _mm256_permute2f128_ps(yLo, yHi, 0x20));
+        _mm256_storeu_ps(oy + 2 * i + 9, _mm256_permute2f128_ps(yLo, yHi, 0x31));
+    }
+
+    dragonScalar(x, y, i, segs, ox, oy);
+}
+// Eight stencil points per step; segments with fewer (two-fold dragon) take the SSE2 path.
+SIMD_TARGET("avx2")
+static bool placeAvx2(const float* x, const float* y, size_t segs, const CompositeStencil* const stencil[2], bool checkLength, float* ox, float* oy)
+{
+    const size_t count = stencil[0]->u.size();
+    if (count < 8) return placeSse2(x, y, segs, stencil, checkLength, ox, oy);
+
+    for (size_t i = 0; i < segs; ++i)
+    {
+        const float dxs = x[i + 1] - x[i];
+        const float dys = y[i + 1] - y[i];
+        if (checkLength && std::sqrt(dxs * dxs + dys * dys) <= 0.0f) return false;
+
+        const __m256 px = _mm256_set1_ps(x[i]), py = _mm256_set1_ps(y[i]);
+        const __m256 dx = _mm256_set1_ps(dxs), dy = _mm256_set1_ps(dys);
+        const float* u = stencil[i & 1]->u.data();
+        const float* v = stencil[i & 1]->v.data();
+        float* ux = ox + count * i + 1;
+        float* uy = oy + count * i + 1;
+
+        for (size_t m = 0; m + 8 <= count; m += 8)
+        {
+            const __m256 su = _mm256_loadu_ps(u + m), sv = _mm256_loadu_ps(v + m);
+            _mm256_storeu_ps(ux + m, _mm256_sub_ps(_mm256_add_ps(px, _mm256_mul_ps(su, dx)), _mm256_mul_ps(sv, dy)));
+            _mm256_storeu_ps(uy + m, _mm256_add_ps(_mm256_add_ps(py, _mm256_mul_ps(su, dy)), _mm256_mul_ps(sv, dx)));
+        }
+
+        ux[count - 1] = x[i + 1];
+        uy[count - 1] = y[i + 1];
+    }
+
+    return true;
+}
+#endif
+
+// Dispatch.
+bool applyKoch2OnceSoA(const CurveSoA& in, CurveSoA& out, SimdLevel level)
+{
+    const size_t n = in.size();
+    if (n < 2)
+    {
+        out = in;
+        return true;
+    }
+
+    const size_t segs = n - 1;
+    out.resize(segs * 8 + 1);
+    out.x[0] = in.x[0];
+    out.y[0] = in.y[0];
+
+    const float* x = in.x.data();
+    const float* y = in.y.data();
+    float* ox = out.x.data();
+    float* oy = out.y.data();
+
+#if defined(TRANSFORMS_SIMD_X86)
+    if (level == SimdLevel::AVX2) return koch2Avx2(x, y, segs, ox, oy);
+    if (level == SimdLevel::SSE2) return koch2Sse2(x, y, segs, ox, oy);
+#endif
+    (void)level;
+
+    return koch2Scalar(x, y, 0, segs, ox, oy);
+}
+
+void applyDragonOnceSoA(const CurveSoA& in, CurveSoA& out, SimdLevel level)
+{
+    const size_t n = in.size();
+    if (n < 2)
+    {
+        out = in;
+        return;
+    }
+
+    const size_t segs = n - 1;
+    out.resize(segs * 2 + 1);
+    out.x[0] = in.x[0];
+    out.y[0] = in.y[0];
+
+    const float* x = in.x.data();
+    const float* y = in.y.data();
+    float* ox = out.x.data();
+    float* oy = out.y.data();
+
+#if defined(TRANSFORMS_SIMD_X86)
+    if (level == SimdLevel::AVX2) { dragonAvx2(x, y, segs, ox, oy); return; }
+    if (level == SimdLevel::SSE2) { dragonSse2(x, y, segs, ox, oy); return; }
+#endif
+    (void)level;
+
+    dragonScalar(x, y, 0, segs, ox, oy);
+}
+
+static bool placeStencilSoA(const CurveSoA& in, CurveSoA& out, const CompositeStencil* const stencil[2], bool checkLength, SimdLevel level)
+{
+    const size_t n = in.size();
+    if (n < 2)
+    {
+        out = in;
+        return true;
+    }
+
+    const size_t segs = n - 1;
+    out.resize(segs * stencil[0]->u.size() + 1);
+    out.x[0] = in.x[0];
+    out.y[0] = in.y[0];
+
+    const float* x = in.x.data();
+    const float* y = in.y.data();
+    float* ox = out.x.data();
+    float* oy = out.y.data();
+
+#if defined(TRANSFORMS_SIMD_X86)
+    if (level == SimdLevel::AVX2) return placeAvx2(x, y, segs, stencil, checkLength, ox, oy);
+    if (level == SimdLevel::SSE2) return placeSse2(x, y, segs, stencil, checkLength, ox, oy);
+#endif
+    (void)level;
+
+    return placeScalar(x, y, 0, segs, stencil, checkLength, ox, oy);
+}
+
+bool applyKoch2FusedSoA(const CurveSoA& in, CurveSoA& out, int levels, SimdLevel level)
+{
+    const CompositeStencil* stencil[2] = { &koch2Stencil(levels), &koch2Stencil(levels) };
+    return placeStencilSoA(in, out, stencil, true, level);
+}
+
+void applyDragonFusedSoA(const CurveSoA& in, CurveSoA& out, int levels, SimdLevel level)
+{
+    const CompositeStencil* stencil[2] = { &dragonStencil(levels, false), &dragonStencil(levels, true) };
+    placeStencilSoA(in, out, stencil, false, level);
+}
+
+// Levels the per-level loop would run from `segs` segments before the curve first holds more
+// than maxSegments points (it stops right after that level), at most `levels`.
+static int levelsWithinBudget(size_t segs, size_t growth, int levels, size_t maxSegments)
+{
+    int run = 0;
+    while (run < levels)
+    {
+        segs *= growth;
+        ++run;
+        if (segs + 1 > maxSegments) break;
+    }
+    return run;
+}
+
+std::vector<glm::vec2> iterateTransformSoA(
+    const std::vector<glm::vec2>& base,
+    int koch2Iters,
+    int dragonIters,
+    size_t maxSegments,
+    SimdLevel level,
+    const std::atomic<bool>* cancel)
+{
+    CurveSoA cur = toSoA(base), next;
+    auto cancelled = [&] { return cancel && cancel->load(std::memory_order_relaxed); };
+
+    // Up to kMaxFusedLevels levels per pass; a lone level runs the per-level kernel.
+    for (int k = 0; k < koch2Iters && !cancelled();)
+    {
+        const int run = levelsWithinBudget(cur.size() - 1, 8, std::min(koch2Iters - k, kMaxFusedLevels), maxSegments);
+
+        if (run > 1 && applyKoch2FusedSoA(cur, next, run, level))
+        {
+            k += run;
+        }
+        else
+        {
+            // Zero-length segments emit a single point; let the reference kernel handle them.
+            if (!applyKoch2OnceSoA(cur, next, level)) next = toSoA(applyKoch2Once(toAoS(cur)));
+            ++k;
+        }
+
+        std::swap(cur, next);
+        if (cur.size() > maxSegments) break;
+    }
+
+    for (int d = 0; d < dragonIters && !cancelled();)
+    {
+        const int run = levelsWithinBudget(cur.size() - 1, 2, std::min(dragonIters - d, kMaxFusedLevels), maxSegments);
+
+        if (run > 1) applyDragonFusedSoA(cur, next, run, level);
+        else applyDragonOnceSoA(cur, next, level);
+        d += run;
+
+        std::swap(cur, next);
+        if (cur.size() > maxSegments) break;
+    }
+
+    return toAoS(cur);
+}
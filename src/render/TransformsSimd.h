@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glm.hpp>
+#include <vector>
+#include <atomic>
+#include <cstddef>
+
+// Instruction sets the SoA kernels can run on.
+enum class SimdLevel { Scalar, SSE2, AVX2 };
+
+// Best level this CPU supports (detected once, then cached).
+SimdLevel detectSimdLevel();
+const char* simdLevelName(SimdLevel level);
+
+// Structure-of-arrays polyline.
+struct CurveSoA
+{
+    std::vector<float> x, y;
+
+    size_t size() const { return x.size(); }
+
+    void resize(size_t n)
+    {
+        x.resize(n);
+        y.resize(n);
+    }
+};
+
+CurveSoA toSoA(const std::vector<glm::vec2>& pts);
+std::vector<glm::vec2> toAoS(const CurveSoA& soa);
+
+// One Koch step. Segment i writes out[8i+1..8i+8], so out is sized up front to 8(n-1)+1.
+// Returns false if a segment has zero length (applyKoch2Once then emits fewer points).
+bool applyKoch2OnceSoA(const CurveSoA& in, CurveSoA& out, SimdLevel level = detectSimdLevel());
+
+// One dragon fold. Segment i writes out[2i+1..2i+2]; out is sized to 2(n-1)+1.
+void applyDragonOnceSoA(const CurveSoA& in, CurveSoA& out, SimdLevel level = detectSimdLevel());
+
+// Fused levels: `levels` (2..kMaxFusedLevels) Koch steps or dragon folds in one pass, placing a
+// precomputed composite stencil (8^levels or 2^levels points per segment) on every segment. The
+// curve is read and written once instead of once per level. Segment ends are exact; points in
+// between differ from the per-level kernels by rounding only: about two float ulps of the
+// coordinates' magnitude (2^-22 max|p|), not of the segment length, so on the short segments
+// of a deep curve the relative difference grows. applyKoch2FusedSoA returns false on a
+// zero-length segment.
+inline constexpr int kMaxFusedLevels = 3;
+
+bool applyKoch2FusedSoA(const CurveSoA& in, CurveSoA& out, int levels, SimdLevel level = detectSimdLevel());
+void applyDragonFusedSoA(const CurveSoA& in, CurveSoA& out, int levels, SimdLevel level = detectSimdLevel());
+
+// Expansion on ping-pong SoA buffers, up to kMaxFusedLevels levels per pass. Same point count
+// and budget rules as iterateTransform (the scalar AoS kernels stay the reference); positions
+// agree to that bound per fused pass. A set `cancel` flag stops between passes.
+std::vector<glm::vec2> iterateTransformSoA(
+    const std::vector<glm::vec2>& base,
+    int koch2Iters,
+    int dragonIters,
+    size_t maxSegments = 200000,
+    SimdLevel level = detectSimdLevel(),
+    const std::atomic<bool>* cancel = nullptr);
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include "Types.h"
+#include "Transforms.h"
+#include "../util/ThreadPool.h"
+
+// ----------Random variants----------
+// A variant draws every orientation choice of a chain from a counter-based RNG instead of the
+// fixed pattern: each rule step mirrors its stencil, and each dragon fold picks its side, on
+// one random bit keyed by (seed, line id) and counted by (stage, level, segment index). A bit
+// is a pure function of those, so any part of the curve at any level can be generated on any
+// thread, in any order, and comes out the same. Mirroring keeps segment lengths and children
+// counts, so point budgets, lengths and kSubtreeReach hold as for the plain chain; levels
+// still nest.
+
+// Segments per parallel chunk of a variant level.
+inline constexpr size_t kVariantGrain = 1 << 12;
+
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"): ten rounds of
+// a keyed bijection on a 128-bit counter.
+inline std::array<uint32_t, 4> philox4x32(std::array<uint32_t, 4> c, std::array<uint32_t, 2> k)
+{
+    for (int round = 0; round < 10; ++round)
+    {
+        const uint64_t p0 = uint64_t(0xD2511F53u) * c[0];
+        const uint64_t p1 = uint64_t(0xCD9E8D57u) * c[2];
+        c = { uint32_t(p1 >> 32) ^ c[1] ^ k[0], uint32_t(p1), uint32_t(p0 >> 32) ^ c[3] ^ k[1], uint32_t(p0) };
+        k[0] += 0x9E3779B9u;
+        k[1] += 0xBB67AE85u;
+    }
+
+    return c;
+}
+
+// RNG key of a line's variant: the seed and the low half of the line id. 0 is the plain chain.
+inline uint64_t variantKey(uint32_t seed, Id lineId)
+{
+    return seed ? (uint64_t(seed) << 32) | uint32_t(lineId) : 0;
+}
+
+// Random bits of one level (stage 0: rule steps, 1: dragon folds). One Philox block covers
+// 128 consecutive segments, so walking a level in order costs a block per 128 bits.
+struct VariantBits
+{
+    uint64_t variant{ 0 };
+    uint32_t stage{ 0 };
+    uint32_t level{ 0 };
+    uint64_t block{ ~uint64_t(0) };
+    std::array<uint32_t, 4> words{};
+
+    bool operator()(uint64_t index)
+    {
+        if ((index >> 7) != block)
+        {
+            block = index >> 7;
+            words = philox4x32({ uint32_t(block), uint32_t(block >> 32), stage << 16 | level, 0 }, { uint32_t(variant >> 32), uint32_t(variant) });
+        }
+
+        return (words[(index >> 5) & 3] >> (index & 31)) & 1;
+    }
+};
+
+// One rule step over segs segments starting at in; the first has index `first` in its level.
+// Writes segs * (N - 1) points, the start point excluded. A zero-length segment becomes N - 1
+// zero-length ones, so every level keeps the children-per-segment layout.
+template <const auto& R>
+inline void variantRuleStep(const glm::vec2* in, size_t segs, VariantBits& bits, uint64_t first, glm::vec2* out)
+{
+    constexpr size_t N = std::size(R.u);
+
+    for (size_t i = 0; i < segs; ++i)
+    {
+        glm::vec2 anchors[N];
+        if (glm::length(in[i + 1] - in[i]) <= 0.0f) std::fill(anchors, anchors + N, in[i + 1]);
+        else ruleAnchors<R>(in[i], in[i + 1], bits(first + i), anchors);
+
+        std::copy(anchors + 1, anchors + N, out + i * (N - 1));
+    }
+}
+
+// One dragon fold, same layout; a set bit folds to the left.
+inline void variantFoldStep(const glm::vec2* in, size_t segs, VariantBits& bits, uint64_t first, glm::vec2* out)
+{
+    for (size_t i = 0; i < segs; ++i)
+    {
+        const glm::vec2 a = in[i];
+        const glm::vec2 b = in[i + 1];
+        const glm::vec2 m = 0.5f * (a + b);
+        const glm::vec2 d = 0.5f * (b - a);
+
+        out[2 * i] = bits(first + i) ? m + rot90L(d) : m + rot90R(d);
+        out[2 * i + 1] = b;
+    }
+}
+
+// Variant of `rule` then the dragon fold, continued from pts (its level (fromK, fromD), or
+// just the base segment) to level (koch2Iters, dragonIters). Every level is split across the
+// pool; a chunk needs only its first segment's index, so chunking never changes the output.
+inline std::vector<glm::vec2> extendVariant(
+    CurveRule rule,
+    uint64_t variant,
+    std::vector<glm::vec2> pts,
+    int fromK,
+    int fromD,
+    int koch2Iters,
+    int dragonIters,
+    const std::atomic<bool>* cancel = nullptr)
+{
+    if (pts.size() < 2) return pts;
+
+    auto level = [&](size_t children, uint32_t stage, int lvl, auto step)
+        {
+            const size_t segs = pts.size() - 1;
+            std::vector<glm::vec2> next(segs * children + 1);
+            next[0] = pts[0];
+
+            sharedThreadPool().parallelFor(segs, kVariantGrain, [&](size_t first, size_t last)
+                {
+                    VariantBits bits{ variant, stage, uint32_t(lvl) };
+                    step(pts.data() + first, last - first, bits, first, next.data() + 1 + first * children);
+                });
+
+            pts.swap(next);
+        };
+
+    withRule(rule, [&](auto tag)
+        {
+            constexpr const auto& R = decltype(tag)::rule;
+            for (int k = fromK; k < koch2Iters && !(cancel && cancel->load()); ++k) level(std::size(R.u) - 1, 0, k, variantRuleStep<R>);
+        });
+
+    for (int d = fromD; d < dragonIters && !(cancel && cancel->load()); ++d) level(2, 1, d, variantFoldStep);
+
+    return pts;
+}
+
+// Culled variant fold; index counts segments within the fold level.
+template <class Sink>
+inline bool streamVariantFold(const glm::vec2& a, const glm::vec2& b, int level, int depth, uint64_t index, VariantBits* bits, CullState& st, Sink& sink)
+{
+    if (!subtreeVisible(a, b, st))
+    {
+        st.broken = true;
+        return true;
+    }
+
+    if (level == depth)
+    {
+        const size_t need = st.broken ? 2 : 1;
+        if (st.budget < need) return false;
+        st.budget -= need;
+
+        if (st.broken) sink(a, true);
+        sink(b, false);
+        st.broken = false;
+        return true;
+    }
+
+    const glm::vec2 m = 0.5f * (a + b);
+    const glm::vec2 d = 0.5f * (b - a);
+    const glm::vec2 k = bits[level](index) ? m + rot90L(d) : m + rot90R(d);
+
+    return streamVariantFold(a, k, level + 1, depth, 2 * index, bits, st, sink)
+        && streamVariantFold(k, b, level + 1, depth, 2 * index + 1, bits, st, sink);
+}
+
+// Culled variant rule step; its leaves are level 0 of the folds.
+template <const auto& R, class Sink>
+inline bool streamVariantRule(const glm::vec2& p, const glm::vec2& q, int level, int ruleDepth, int dragonDepth, uint64_t index,
+    VariantBits* ruleBits, VariantBits* foldBits, CullState& st, Sink& sink)
+{
+    constexpr size_t N = std::size(R.u);
+
+    if (level == ruleDepth) return streamVariantFold(p, q, 0, dragonDepth, index, foldBits, st, sink);
+
+    if (!subtreeVisible(p, q, st))
+    {
+        st.broken = true;
+        return true;
+    }
+
+    glm::vec2 anchors[N];
+    if (glm::length(q - p) <= 0.0f) std::fill(anchors, anchors + N, q);
+    else ruleAnchors<R>(p, q, ruleBits[level](index), anchors);
+
+    for (size_t k = 0; k + 1 < N; ++k)
+    {
+        if (!streamVariantRule<R>(anchors[k], anchors[k + 1], level + 1, ruleDepth, dragonDepth, index * (N - 1) + k, ruleBits, foldBits, st, sink)) return false;
+    }
+
+    return true;
+}
+
+// View-culled streaming generator for a variant; protocol and return value as
+// streamTransformCulled, the same points as extendVariant where visible.
+template <class Sink>
+inline bool streamVariantCulled(
+    CurveRule rule,
+    uint64_t variant,
+    const glm::vec2& a,
+    const glm::vec2& b,
+    int koch2Iters,
+    int dragonIters,
+    const glm::vec2& viewMin,
+    const glm::vec2& viewMax,
+    float margin,
+    Sink&& sink,
+    size_t maxPoints = kMaxCurvePoints)
+{
+    CullState st{ viewMin - glm::vec2(margin), viewMax + glm::vec2(margin), maxPoints, true };
+
+    koch2Iters = std::max(0, koch2Iters);
+    dragonIters = std::max(0, dragonIters);
+
+    std::vector<VariantBits> ruleBits(koch2Iters), foldBits(dragonIters);
+    for (int k = 0; k < koch2Iters; ++k) ruleBits[k] = { variant, 0, uint32_t(k) };
+    for (int d = 0; d < dragonIters; ++d) foldBits[d] = { variant, 1, uint32_t(d) };
+
+    return withRule(rule, [&](auto tag)
+        {
+            return streamVariantRule<decltype(tag)::rule>(a, b, 0, koch2Iters, dragonIters, 0, ruleBits.data(), foldBits.data(), st, sink);
+        });
+}
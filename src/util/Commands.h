@@ -196,7 +196,7 @@ struct CmdEditEndpoints : ICommand
     {
         if (auto* l = findLine(doc, id))
         {
-            l->a = a1; l->b = b1; l->dirty = true;
+            l->a = a1; l->b = b1;
         }
     }
 
@@ -204,7 +204,7 @@ struct CmdEditEndpoints : ICommand
     {
         if (auto* l = findLine(doc, id))
         {
-            l->a = a0; l->b = b0; l->dirty = true;
+            l->a = a0; l->b = b0;
         }
     }
 };
@@ -224,7 +224,7 @@ struct CmdMoveLine : ICommand
     {
         if (auto* l = findLine(doc, id))
         {
-            l->a += da; l->b += da; l->dirty = true;
+            l->a += da; l->b += da;
         }
     }
 
@@ -232,7 +232,7 @@ struct CmdMoveLine : ICommand
     {
         if (auto* l = findLine(doc, id))
         {
-            l->a -= da; l->b -= da; l->dirty = true;
+            l->a -= da; l->b -= da;
         }
     }
 };
@@ -270,10 +270,14 @@ struct CmdStyle : ICommand
 struct CmdTransforms : ICommand
 {
     Id id{ 0 };
+    CurveRule r0{}, r1{};
+    std::shared_ptr<const LSystemProgram> s0, s1;
     int k0{}, d0{}, k1{}, d1{};
+    uint32_t seed0{}, seed1{};
 
-    CmdTransforms(Id i, int oldK, int oldD, int newK, int newD)
-        : id(i), k0(oldK), d0(oldD), k1(newK), d1(newD)
+    CmdTransforms(Id i, CurveRule oldR, std::shared_ptr<const LSystemProgram> oldS, int oldK, int oldD, uint32_t oldSeed,
+        CurveRule newR, std::shared_ptr<const LSystemProgram> newS, int newK, int newD, uint32_t newSeed)
+        : id(i), r0(oldR), r1(newR), s0(std::move(oldS)), s1(std::move(newS)), k0(oldK), d0(oldD), k1(newK), d1(newD), seed0(oldSeed), seed1(newSeed)
     {
     }
 
@@ -281,7 +285,7 @@ struct CmdTransforms : ICommand
     {
         if (auto* l = findLine(doc, id))
         {
-            l->koch2Iters = k1; l->dragonIters = d1; l->dirty = true;
+            l->rule = r1; l->lsystem = s1; l->koch2Iters = k1; l->dragonIters = d1; l->seed = seed1;
         }
     }
 
@@ -289,7 +293,7 @@ struct CmdTransforms : ICommand
     {
         if (auto* l = findLine(doc, id))
         {
-            l->koch2Iters = k0; l->dragonIters = d0; l->dirty = true;
+            l->rule = r0; l->lsystem = s0; l->koch2Iters = k0; l->dragonIters = d0; l->seed = seed0;
         }
     }
 };
@@ -313,7 +317,7 @@ struct CmdEditManyEndpoints : ICommand
         {
             if (auto* l = findLine(doc, ids[i]))
             {
-                l->a = a1[i]; l->b = b1[i]; l->dirty = true;
+                l->a = a1[i]; l->b = b1[i];
             }
         }
     }
@@ -324,7 +328,7 @@ struct CmdEditManyEndpoints : ICommand
         {
             if (auto* l = findLine(doc, ids[i]))
             {
-                l->a = a0[i]; l->b = b0[i]; l->dirty = true;
+                l->a = a0[i]; l->b = b0[i];
             }
         }
     }
@@ -378,19 +382,32 @@ struct CmdStyleMany : ICommand
 struct CmdTransformsMany : ICommand
 {
     std::vector<Id> ids;
+    std::vector<CurveRule> r0;
+    std::vector<std::shared_ptr<const LSystemProgram>> s0;
     std::vector<int> k0, d0;
+    std::vector<uint32_t> seed0;
+    CurveRule r1;
+    std::shared_ptr<const LSystemProgram> s1;
     int k1, d1;
+    uint32_t seed1;
 
-    CmdTransformsMany(std::vector<Id> ids_, int newK, int newD, const Document& doc)
-        : ids(std::move(ids_)), k1(newK), d1(newD)
+    // newS, when set, replaces the built-in rule as the first stage. newSeed 0 is the plain chain.
+    CmdTransformsMany(std::vector<Id> ids_, CurveRule newR, std::shared_ptr<const LSystemProgram> newS, int newK, int newD, uint32_t newSeed, const Document& doc)
+        : ids(std::move(ids_)), r1(newR), s1(std::move(newS)), k1(newK), d1(newD), seed1(newSeed)
     {
+        r0.reserve(ids.size());
+        s0.reserve(ids.size());
         k0.reserve(ids.size());
         d0.reserve(ids.size());
+        seed0.reserve(ids.size());
         for (auto id : ids)
         {
             auto* l = findLine(const_cast<Document&>(doc), id);
+            r0.push_back(l ? l->rule : CurveRule::Koch2);
+            s0.push_back(l ? l->lsystem : nullptr);
             k0.push_back(l ? l->koch2Iters : 0);
             d0.push_back(l ? l->dragonIters : 0);
+            seed0.push_back(l ? l->seed : 0);
         }
     }
 
@@ -400,7 +417,7 @@ struct CmdTransformsMany : ICommand
         {
             if (auto* l = findLine(doc, id))
             {
-                l->koch2Iters = k1; l->dragonIters = d1; l->dirty = true;
+                l->rule = r1; l->lsystem = s1; l->koch2Iters = k1; l->dragonIters = d1; l->seed = seed1;
             }
         }
     }
@@ -411,7 +428,7 @@ struct CmdTransformsMany : ICommand
         {
             if (auto* l = findLine(doc, ids[i]))
             {
-                l->koch2Iters = k0[i]; l->dragonIters = d0[i]; l->dirty = true;
+                l->rule = r0[i]; l->lsystem = s0[i]; l->koch2Iters = k0[i]; l->dragonIters = d0[i]; l->seed = seed0[i];
             }
         }
     }
@@ -538,7 +555,7 @@ struct CmdRegularPolyParams : ICommand
             glm::vec2 p1 = g.center + g.radius * glm::vec2(std::cos(t1), std::sin(t1));
             if (auto* l = findLine(doc, g.lineIds[i]))
             {
-                l->a = p0; l->b = p1; l->dirty = true;
+                l->a = p0; l->b = p1;
             }
         }
     }
@@ -12,12 +12,32 @@
 
 using json = nlohmann::json;
 
+// Vertices tessellated before export draws and empties the mesh (24 MB of vertices).
+static constexpr size_t kExportFlushVertices = size_t(1) << 20;
+
 bool saveStateJSON(const Document& doc, const std::string& path) 
 {
     json j;
     j["version"] = 1;
     j["cam"] = { {"cx", doc.camCenter.x}, {"cy", doc.camCenter.y}, {"zoom", doc.camZoom} };
 
+    auto& rules = j["lsystems"] = json::array();
+
+    for (auto& p : doc.lsystems)
+    {
+        const LSystemSource& src = p->source;
+        json R;
+
+        R["name"] = src.name;
+        R["axiom"] = src.axiom;
+        auto& prods = R["productions"] = json::object();
+        for (auto& pr : src.productions) prods[std::string(1, pr.first)] = pr.second;
+        R["angle"] = src.angleDeg;
+        R["scale"] = src.stepScale;
+
+        rules.push_back(R);
+    }
+
     auto& arr = j["lines"] = json::array();
 
     for (auto& l : doc.originals) 
@@ -29,8 +49,11 @@ bool saveStateJSON(const Document& doc, const std::string& path)
         L["bx"] = l.b.x; L["by"] = l.b.y;
         L["color"] = { l.color.r, l.color.g, l.color.b, l.color.a };
         L["thickness"] = l.thicknessPx;
+        L["rule"] = ruleInfo(l.rule).name;
+        if (l.lsystem) L["lsystem"] = l.lsystem->source.name;
         L["koch2"] = l.koch2Iters;
         L["dragon"] = l.dragonIters;
+        if (l.seed) L["seed"] = l.seed;
 
         arr.push_back(L);
     }
@@ -52,6 +75,7 @@ bool loadStateJSON(Document& doc, const std::string& path)
 
     json j; f >> j;
     doc.originals.clear();
+    doc.lsystems.clear();
     doc.nextId = 1;
 
     if (j.contains("cam")) 
@@ -62,6 +86,30 @@ bool loadStateJSON(Document& doc, const std::string& path)
         doc.camZoom = c.value("zoom", 1.f);
     }
 
+    // Rules compile once here; one that no longer compiles is dropped and its lines fall back
+    // to their built-in rule.
+    if (j.contains("lsystems"))
+    {
+        for (auto& R : j["lsystems"])
+        {
+            LSystemSource src;
+            src.name = R.value("name", std::string());
+            src.axiom = R.value("axiom", std::string());
+            if (R.contains("productions"))
+            {
+                for (auto& pr : R["productions"].items())
+                {
+                    if (pr.key().size() == 1) src.productions.push_back({ pr.key()[0], pr.value().get<std::string>() });
+                }
+            }
+            src.angleDeg = R.value("angle", 90.f);
+            src.stepScale = R.value("scale", 1.f);
+
+            std::string error;
+            if (auto prog = compileLSystem(src, error); prog && !findLSystem(doc, src.name)) doc.lsystems.push_back(std::move(prog));
+        }
+    }
+
     for (auto& L : j["lines"]) 
     {
         Line l;
@@ -75,9 +123,15 @@ bool loadStateJSON(Document& doc, const std::string& path)
 
         l.color = { col[0], col[1], col[2], col[3] };
         l.thicknessPx = L.value("thickness", 3.f);
+        const std::string rule = L.value("rule", std::string());
+        for (int r = 0; r < kCurveRuleCount; ++r)
+        {
+            if (rule == ruleInfo(CurveRule(r)).name) l.rule = CurveRule(r);
+        }
+        if (L.contains("lsystem")) l.lsystem = findLSystem(doc, L["lsystem"].get<std::string>());
         l.koch2Iters = L.value("koch2", 0);
         l.dragonIters = L.value("dragon", 0);
-        l.dirty = true;
+        l.seed = L.value("seed", 0u);
         doc.originals.push_back(l);
     }
 
@@ -97,7 +151,7 @@ static glm::mat4 makeViewProjFor(const Document& doc, int w, int h)
     return proj * (tr * sc * tr2);
 }
 
-bool saveCanvasPNG(Renderer2D& renderer, const Document& doc, int outW, int outH, const std::string& filename) 
+bool saveCanvasPNG(Renderer2D& renderer, const Document& doc, int outW, int outH, const std::string& filename, float lodTolerancePx) 
 {
     if (outW <= 0 || outH <= 0) return false;
 
@@ -149,14 +203,39 @@ bool saveCanvasPNG(Renderer2D& renderer, const Document& doc, int outW, int outH
     const glm::mat4 VP = makeViewProjFor(doc, outW, outH);
     renderer.begin(VP);
 
-    // Effects. If effect cache is empty, draw the base segment.
+    const float pxPerUnit = viewPixelScale(VP, outW, outH);
+
+    // World rectangle of the image.
+    const glm::vec2 half(0.5f * outW / doc.camZoom, 0.5f * outH / doc.camZoom);
+    const glm::vec2 viewMin = doc.camCenter - half, viewMax = doc.camCenter + half;
+
+    // Effects. Lines holding a template of other depths (still building, budget- or
+    // LOD-clamped on screen) are streamed at their full depth with no point cap: built-in
+    // chains only where they meet the image. The mesh is drawn whenever it fills up, so
+    // memory stays bounded however many vertices a line has.
+    renderer.setFlushVertices(kExportFlushVertices);
+
     for (const auto& l : doc.originals) 
     {
-        const std::vector<glm::vec2>& poly = l.effect.empty()
-            ? (const std::vector<glm::vec2>&)std::vector<glm::vec2>{ l.a, l.b }
-        : l.effect;
+        int k = l.koch2Iters, d = l.dragonIters;
+        if (lodTolerancePx > 0.f) lodClampIters(glm::length(l.b - l.a) * pxPerUnit, lodTolerancePx, k, d, lineRuleShrink(l));
 
-        renderer.submitPolyline(poly, l.thicknessPx, l.color);
+        if (effectCurrent(l, k, d))
+        {
+            renderer.submitPlaced(*l.effect, l.a, l.b, l.thicknessPx, l.color);
+        }
+        else if (l.lsystem)
+        {
+            renderer.submitLSystem(*l.lsystem, l.a, l.b, k, d, l.thicknessPx, l.color, SIZE_MAX);
+        }
+        else if (const uint64_t variant = lineVariant(l))
+        {
+            renderer.submitVariantCulled(l.rule, variant, l.a, l.b, k, d, viewMin, viewMax, l.thicknessPx, l.color, SIZE_MAX);
+        }
+        else
+        {
+            renderer.submitCurveCulled(l.rule, l.a, l.b, k, d, viewMin, viewMax, l.thicknessPx, l.color, SIZE_MAX);
+        }
     }
 
     // Originals.
@@ -194,6 +273,7 @@ bool saveCanvasPNG(Renderer2D& renderer, const Document& doc, int outW, int outH
     }
 
     renderer.end();
+    renderer.setFlushVertices(0);
 
     // Read back pixels.
     std::vector<unsigned char> pixels(size_t(outW) * size_t(outH) * 4);
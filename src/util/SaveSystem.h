@@ -6,4 +6,5 @@
 
 bool saveStateJSON(const Document& doc, const std::string& path);
 bool loadStateJSON(Document& doc, const std::string& path);
-bool saveCanvasPNG(Renderer2D& renderer, const Document& doc, int outW, int outH, const std::string& filename);
\ No newline at end of file
+// lodTolerancePx > 0 applies screen-space LOD for the output resolution; 0 renders full depth.
+bool saveCanvasPNG(Renderer2D& renderer, const Document& doc, int outW, int outH, const std::string& filename, float lodTolerancePx = 0.f);
\ No newline at end of file
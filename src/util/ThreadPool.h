@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Work-stealing pool. Every worker owns a deque: it pops its own newest task (LIFO, so nested
+// work runs hot) and steals the oldest task from others when it runs dry. Threads that wait
+// for a batch keep executing queued tasks, so nested batches cannot deadlock. Threads outside
+// the pool (the UI, the effect builder) own no queue and, while waiting, run only tasks of
+// their own batch, so a frame never ends up running someone else's long build.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned threads = std::max(1u, std::thread::hardware_concurrency()))
+    {
+        // The calling thread always helps, so one fewer worker keeps every core busy.
+        const unsigned workerCount = threads > 1 ? threads - 1 : 0;
+        for (unsigned i = 0; i < workerCount; ++i) queues.push_back(std::make_unique<Queue>());
+
+        for (unsigned i = 0; i < workerCount; ++i)
+        {
+            workers.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMtx);
+            stopping = true;
+        }
+        sleepCv.notify_all();
+
+        for (auto& t : workers) t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Threads that run work, including the caller of run/parallelFor.
+    size_t concurrency() const { return workers.size() + 1; }
+
+    // Run every task and block until all finish. Tasks are dealt round-robin in the given
+    // order, so put the most expensive first and they start first.
+    void run(std::vector<std::function<void()>> tasks)
+    {
+        if (tasks.empty()) return;
+
+        if (workers.empty() || tasks.size() == 1)
+        {
+            for (auto& t : tasks) t();
+            return;
+        }
+
+        // Shared so a finishing task can still signal after the waiter has returned.
+        auto group = std::make_shared<Group>();
+        group->pending = tasks.size();
+
+        // Count first so workers never see the counter dip below what is queued.
+        queued.fetch_add(tasks.size());
+
+        // Deal in reverse so each deque's newest (owner-side) entry is its most expensive task.
+        const size_t n = queues.size();
+        const size_t self = currentQueue();
+        const size_t home = self == kOutside ? 0 : self;
+        for (size_t i = tasks.size(); i-- > 0;)
+        {
+            Queue& q = *queues[(home + i) % n];
+            std::lock_guard<std::mutex> lock(q.mtx);
+            q.tasks.push_back({ std::move(tasks[i]), group });
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(sleepMtx);
+        }
+        sleepCv.notify_all();
+
+        wait(*group);
+    }
+
+    // Split [0, count) into chunks of at least `grain` and run fn(begin, end) on every thread.
+    // Blocks until all chunks finish. Safe to call from inside a task.
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn)
+    {
+        if (count == 0) return;
+
+        grain = std::max<size_t>(1, grain);
+        const size_t maxChunks = concurrency() * 4;
+        const size_t chunk = std::max(grain, (count + maxChunks - 1) / maxChunks);
+
+        if (workers.empty() || chunk >= count)
+        {
+            fn(0, count);
+            return;
+        }
+
+        std::vector<std::function<void()>> tasks;
+        tasks.reserve((count + chunk - 1) / chunk);
+
+        for (size_t begin = 0; begin < count; begin += chunk)
+        {
+            const size_t end = std::min(count, begin + chunk);
+            tasks.push_back([&fn, begin, end] { fn(begin, end); });
+        }
+
+        run(std::move(tasks));
+    }
+
+private:
+    struct Group
+    {
+        std::atomic<size_t> pending{ 0 };
+        std::mutex mtx;
+        std::condition_variable cv;
+    };
+
+    struct Task
+    {
+        std::function<void()> fn;
+        std::shared_ptr<Group> group;
+    };
+
+    struct Queue
+    {
+        std::mutex mtx;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queued{ 0 };
+    std::mutex sleepMtx;
+    std::condition_variable sleepCv;
+    bool stopping{ false };
+
+    static constexpr size_t kOutside = ~size_t(0);
+
+    // Index of the calling thread's own queue; kOutside for threads outside the pool.
+    size_t currentQueue() const
+    {
+        return workerIndex().first == this ? workerIndex().second : kOutside;
+    }
+
+    static std::pair<const ThreadPool*, size_t>& workerIndex()
+    {
+        thread_local std::pair<const ThreadPool*, size_t> index{ nullptr, 0 };
+        return index;
+    }
+
+    // Pop own newest task, else steal the oldest task of another queue.
+    bool takeTask(size_t self, Task& out)
+    {
+        {
+            Queue& q = *queues[self];
+            std::lock_guard<std::mutex> lock(q.mtx);
+            if (!q.tasks.empty())
+            {
+                out = std::move(q.tasks.back());
+                q.tasks.pop_back();
+                queued.fetch_sub(1);
+                return true;
+            }
+        }
+
+        const size_t n = queues.size();
+        for (size_t k = 1; k < n; ++k)
+        {
+            Queue& q = *queues[(self + k) % n];
+            std::lock_guard<std::mutex> lock(q.mtx);
+            if (!q.tasks.empty())
+            {
+                out = std::move(q.tasks.front());
+                q.tasks.pop_front();
+                queued.fetch_sub(1);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Newest queued task of `group`, wherever it was dealt.
+    bool takeGroupTask(const Group& group, Task& out)
+    {
+        for (auto& qp : queues)
+        {
+            Queue& q = *qp;
+            std::lock_guard<std::mutex> lock(q.mtx);
+            for (auto it = q.tasks.end(); it != q.tasks.begin();)
+            {
+                if ((--it)->group.get() != &group) continue;
+
+                out = std::move(*it);
+                q.tasks.erase(it);
+                queued.fetch_sub(1);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Workers take any task; outside threads only their own group's.
+    bool runOne(size_t self, const Group* own = nullptr)
+    {
+        Task task;
+        if (own ? !takeGroupTask(*own, task) : !takeTask(self, task)) return false;
+
+        task.fn();
+
+        if (task.group->pending.fetch_sub(1) == 1)
+        {
+            std::lock_guard<std::mutex> lock(task.group->mtx);
+            task.group->cv.notify_all();
+        }
+
+        return true;
+    }
+
+    // Help with queued work until the group drains; sleep briefly only when nothing is queued.
+    void wait(Group& group)
+    {
+        const size_t self = currentQueue();
+
+        while (group.pending.load() > 0)
+        {
+            if (runOne(self, self == kOutside ? &group : nullptr)) continue;
+
+            std::unique_lock<std::mutex> lock(group.mtx);
+            group.cv.wait_for(lock, std::chrono::microseconds(200), [&] { return group.pending.load() == 0; });
+        }
+    }
+
+    void workerLoop(size_t self)
+    {
+        workerIndex() = { this, self };
+
+        for (;;)
+        {
+            if (runOne(self)) continue;
+
+            std::unique_lock<std::mutex> lock(sleepMtx);
+            sleepCv.wait(lock, [&] { return stopping || queued.load() > 0; });
+            if (stopping) return;
+        }
+    }
+};
+
+// Process-wide pool shared by the curve generators and effect rebuilds.
+inline ThreadPool& sharedThreadPool()
+{
+    static ThreadPool pool;
+    return pool;
+}